@@ -13,9 +13,40 @@
 #include "al/ui/al_ControlGUI.hpp"
 #include "al/ui/al_Parameter.hpp"
 
+#include "block_biquad.h"
+#include "notes.h"
+#include "voice_params.h"
+
 using namespace gam;
 using namespace al;
 using namespace std;
+
+// samples between filter coefficient updates (1 = every sample)
+static const int FILTER_CTL_RATE = 32;
+
+// Parameter block for MiniSubWaves, filled from cached parameter handles
+struct MiniSubWavesParams
+{
+    float amplitude = 0.3f;
+    float frequency = 60.0f;
+    float oscMix = 0.5f;
+    float noise = 0.0f;
+    float ampEnvAtk = 0.1f;
+    float ampEnvDec = 0.01f;
+    float ampEnvSus = 0.8f;
+    float ampEnvRel = 0.4f;
+    float ampEnvCve = 4.0f;
+    float filtEnvAtk = 0.1f;
+    float filtEnvDec = 0.01f;
+    float filtEnvSus = 0.8f;
+    float filtEnvRel = 0.4f;
+    float filtEnvCve = 4.0f;
+    float filtEnvDpth = 0.0f;
+    float filtFreq = 2400.0f;
+    float filtRes = 0.1f;
+    float pan = 0.0f;
+};
+
 class MiniSubWaves : public SynthVoice
 {
 public:
@@ -28,7 +59,12 @@ public:
     gam::Saw<> mOsc0;
     gam::DWO<> mOsc1;
     gam::NoiseWhite<> mNoise;
-    gam::Biquad<> mFilter;
+    BlockBiquad mFilter{FILTER_CTL_RATE}; // resonant LP, retuned at block rate
+
+    // Parameters, read by the render loop without string lookups
+    ParamHandles<MiniSubWavesParams> mHandles;
+    MiniSubWavesParams mParams;
+
     // Additional members
     Mesh mMesh;
 
@@ -46,24 +82,24 @@ public:
         // We have the mesh be a sphere
         addDisc(mMesh, 1.0, 30);
 
-        createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("oscMix", 0.5, 0.0, 1.0);
-        createInternalTriggerParameter("noise", 0.0, 0.0, 1.0);
-        createInternalTriggerParameter("ampEnvAtk", 0.1, 0.01, 2.0);
-        createInternalTriggerParameter("ampEnvDec", 0.01, 0.01, 2.0);
-        createInternalTriggerParameter("ampEnvSus", 0.8, 0.0, 1.0);
-        createInternalTriggerParameter("ampEnvRel", 0.4, 0.05, 2.0);
-        createInternalTriggerParameter("ampEnvCve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("filtEnvAtk", 0.1, 0.01, 2.0);
-        createInternalTriggerParameter("filtEnvDec", 0.01, 0.01, 2.0);
-        createInternalTriggerParameter("filtEnvSus", 0.8, 0.0, 1.0);
-        createInternalTriggerParameter("filtEnvRel", 0.4, 0.05, 2.0);
-        createInternalTriggerParameter("filtEnvCve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("filtEnvDpth", 0.0, -400, 4800);
-        createInternalTriggerParameter("filtFreq", 2400.0, 10.0, 5000);
-        createInternalTriggerParameter("filtRes", 0.1, 0.01, 10);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+        mHandles.bind(&MiniSubWavesParams::amplitude, createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::frequency, createInternalTriggerParameter("frequency", 60, 20, 5000));
+        mHandles.bind(&MiniSubWavesParams::oscMix, createInternalTriggerParameter("oscMix", 0.5, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::noise, createInternalTriggerParameter("noise", 0.0, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvAtk, createInternalTriggerParameter("ampEnvAtk", 0.1, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvDec, createInternalTriggerParameter("ampEnvDec", 0.01, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvSus, createInternalTriggerParameter("ampEnvSus", 0.8, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvRel, createInternalTriggerParameter("ampEnvRel", 0.4, 0.05, 2.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvCve, createInternalTriggerParameter("ampEnvCve", 4.0, -10.0, 10.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvAtk, createInternalTriggerParameter("filtEnvAtk", 0.1, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvDec, createInternalTriggerParameter("filtEnvDec", 0.01, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvSus, createInternalTriggerParameter("filtEnvSus", 0.8, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvRel, createInternalTriggerParameter("filtEnvRel", 0.4, 0.05, 2.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvCve, createInternalTriggerParameter("filtEnvCve", 4.0, -10.0, 10.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvDpth, createInternalTriggerParameter("filtEnvDpth", 0.0, -400, 4800));
+        mHandles.bind(&MiniSubWavesParams::filtFreq, createInternalTriggerParameter("filtFreq", 2400.0, 10.0, 5000));
+        mHandles.bind(&MiniSubWavesParams::filtRes, createInternalTriggerParameter("filtRes", 0.1, 0.01, 10));
+        mHandles.bind(&MiniSubWavesParams::pan, createInternalTriggerParameter("pan", 0.0, -1.0, 1.0));
     }
 
     //
@@ -71,11 +107,11 @@ public:
     virtual void onProcess(AudioIOData &io) override
     {
         updateFromParameters();
-        float amp = getInternalParameterValue("amplitude");
-        float filtFreq = getInternalParameterValue("filtFreq");
-        float filtEnvDepth = getInternalParameterValue("filtEnvDpth");
-        float oscMix = getInternalParameterValue("oscMix");
-        float noiseMix = getInternalParameterValue("noise");
+        float amp = mParams.amplitude;
+        float filtFreq = mParams.filtFreq;
+        float filtEnvDepth = mParams.filtEnvDpth;
+        float oscMix = mParams.oscMix;
+        float noiseMix = mParams.noise;
         while (io())
         {
             // mix oscillator with noise
@@ -117,6 +153,8 @@ public:
     }
     virtual void onTriggerOn() override
     {
+        mFilter.sampleRate(gam::sampleRate());
+        mFilter.reset();
         updateFromParameters();
         mAmpEnv.reset();
         mFiltEnv.reset();
@@ -130,25 +168,27 @@ public:
 
     void updateFromParameters()
     {
-        mOsc0.freq(getInternalParameterValue("frequency"));
-        mOsc1.freq(getInternalParameterValue("frequency"));
+        mHandles.pull(mParams);
+
+        mOsc0.freq(mParams.frequency);
+        mOsc1.freq(mParams.frequency);
 
-        mAmpEnv.attack(getInternalParameterValue("ampEnvAtk"));
-        mAmpEnv.decay(getInternalParameterValue("ampEnvDec"));
-        mAmpEnv.sustain(getInternalParameterValue("ampEnvSus"));
-        mAmpEnv.release(getInternalParameterValue("ampEnvRel"));
-        mAmpEnv.curve(getInternalParameterValue("ampEnvCve"));
+        mAmpEnv.attack(mParams.ampEnvAtk);
+        mAmpEnv.decay(mParams.ampEnvDec);
+        mAmpEnv.sustain(mParams.ampEnvSus);
+        mAmpEnv.release(mParams.ampEnvRel);
+        mAmpEnv.curve(mParams.ampEnvCve);
 
-        mPan.pos(getInternalParameterValue("pan"));
+        mPan.pos(mParams.pan);
 
-        mFilter.freq(getInternalParameterValue("filtFreq"));
-        mFilter.res(getInternalParameterValue("filtRes"));
+        mFilter.freq(mParams.filtFreq);
+        mFilter.res(mParams.filtRes);
 
-        mFiltEnv.attack(getInternalParameterValue("filtEnvAtk"));
-        mFiltEnv.decay(getInternalParameterValue("filtEnvDec"));
-        mFiltEnv.sustain(getInternalParameterValue("filtEnvSus"));
-        mFiltEnv.release(getInternalParameterValue("filtEnvRel"));
-        mFiltEnv.curve(getInternalParameterValue("filtEnvCve"));
+        mFiltEnv.attack(mParams.filtEnvAtk);
+        mFiltEnv.decay(mParams.filtEnvDec);
+        mFiltEnv.sustain(mParams.filtEnvSus);
+        mFiltEnv.release(mParams.filtEnvRel);
+        mFiltEnv.curve(mParams.filtEnvCve);
     }
 };
 
@@ -219,8 +259,7 @@ public:
             int midiNote = asciiToMIDI(k.key());
             if (midiNote > 0)
             {
-                synthManager.voice()->setInternalParameterValue(
-                    "frequency", ::pow(2.f, (midiNote - 69.f) / 12.f) * 432.f);
+                synthManager.voice()->setInternalParameterValue("frequency", MIDI_432[midiNote]);
                 synthManager.triggerOn(midiNote);
             }
         }
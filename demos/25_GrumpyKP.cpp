@@ -12,10 +12,34 @@
 #include "al/ui/al_ControlGUI.hpp"
 #include "al/ui/al_Parameter.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <vector>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 #include "notes.h"
+#include "alloc_counter.h"
+#include "audio_profiler.h"
+#include "bench/bench.h"
+#include "block_biquad.h"
+#include "block_noise.h"
+#include "fastmath.h"
+#include "fm_operators.h"
+#include "fixed_comb.h"
+#include "minisub_bank.h"
+#include "note_engine.h"
+#include "offline_render.h"
+#include "output_meter.h"
+#include "parallel_voices.h"
+#include "sequence.h"
+#include "sequence_file.h"
+#include "voice_params.h"
+#include "voice_pool.h"
+#include "wavetable.h"
 
 // using namespace gam;
 using namespace al;
@@ -26,124 +50,171 @@ enum Instrument
     INSTR_KPS,
     INSTR_MSBASS,
     INSTR_FM,
+    INSTR_PLUCK, // KPSWaves in pluck mode: a short burst, then only the string
     NUM_INSTRUMENTS
 };
 
-static const float SEMITONE_RATIO = 1.0594630943592952646;
-static const float CENT_RATIO = 1.0005777895065548;
+// samples between filter coefficient updates (1 = every sample)
+static const int FILTER_CTL_RATE = 32;
 
-// https://en.wikipedia.org/wiki/Equal_temperament#General_formulas_for_the_equal-tempered_interval
-float note_freq(uint16_t note) { return 440 * std::pow(SEMITONE_RATIO, note - 0x45); }
+// polyphony: notes each instrument may play at once (see INSTRUMENTS), and
+// at most MAX_VOICES in all. When a callback takes more than CPU_BUDGET of
+// its block's duration the cap drops (to no fewer than MIN_VOICES) and the
+// quietest notes are stolen, fading out over STEAL_RELEASE seconds.
+static const int MAX_VOICES = 128;
+static const float CPU_BUDGET = 0.7f;
+static const int MIN_VOICES = 8;
+static const float STEAL_RELEASE = 0.005f;
+
+// a released note stops rendering once its envelope and its output are
+// both below this level (-60 dB)
+static const float RETIRE_LEVEL = 0.001f;
 
-float detune(float freq, int cents) { return freq * std::pow(CENT_RATIO, cents); }
+// render MiniSubWaves notes through the vectorized MiniSubBank,
+// MINISUB_BANK_WIDTH voices at a time (4, 8 or 16)
+static const bool MINISUB_USE_BANK = true;
+static const int MINISUB_BANK_WIDTH = 8;
 
-class TimeSignature
+MiniSubBank<MINISUB_BANK_WIDTH> &miniSubBank()
 {
-private:
-    int upper;
-    int lower;
+    static MiniSubBank<MINISUB_BANK_WIDTH> bank;
+    return bank;
+}
 
-public:
-    TimeSignature()
-    {
-        this->upper = 7;
-        this->lower = 4;
-    }
-};
+// band-limited saw and square tables the voices' oscillators share; built
+// with the voice pools (see MyApp::allocateVoices())
+WavetableBank &wavetables()
+{
+    static WavetableBank tables;
+    return tables;
+}
+
+// every note's noise is its own stream from NOISE_SEED, handed out in the
+// order notes start, so an offline render comes out the same every time
+static const uint32_t NOISE_SEED = 0x5EED;
 
-class Note
+NoiseStreams &noiseStreams()
 {
-private:
-    float freq;
-    float time;
-    float duration;
-    float amp;
-    float attack;
-    float decay;
+    static NoiseStreams streams;
+    return streams;
+}
 
-public:
-    Note()
-    {
-        this->freq = 440.0;
-        this->time = 0;
-        this->duration = 0.5;
-        this->amp = 0.2;
-        this->attack = 0.05;
-        this->decay = 0.05;
-    }
-    Note(float freq,
-         float time = 0.0f,
-         float duration = 0.5f,
-         float amp = 0.2f,
-         float attack = 0.05f,
-         float decay = 0.05f)
-    {
-        this->freq = freq;
-        this->time = time;
-        this->duration = duration;
-        this->amp = amp;
-        this->attack = attack;
-        this->decay = decay;
-    }
-    // Return an identical note, but offset by the
-    // number of beats indicated by beatOffset,
-    // and with amplitude multiplied by ampMult
-    Note(const Note &n, float beatOffset, float ampMult = 1.0f)
-    {
-        this->freq = n.freq;
-        this->time = n.time + beatOffset;
-        this->duration = n.duration;
-        this->amp = n.amp * ampMult;
-        this->attack = n.attack;
-        this->decay = n.decay;
-    }
-    Note(const Note &n)
-    {
-        this->freq = n.freq;
-        this->time = n.time;
-        this->duration = n.duration;
-        this->amp = n.amp;
-        this->attack = n.attack;
-        this->decay = n.decay;
-    }
-    float getFreq() { return this->freq; }
-    float getTime() { return this->time; }
-    float getDuration() { return this->duration; }
-    float getAmp() { return this->amp; }
-    float getAttack() { return this->attack; }
-    float getDecay() { return this->decay; }
+// render voices on this many threads (the audio thread plus workers);
+// 1 renders every voice on the audio thread
+static const int RENDER_THREADS = 4;
+// voices per block the threads can take; any beyond that render inline
+static const int RENDER_MAX_VOICES = 64;
+
+ParallelVoices &parallelVoices()
+{
+    static ParallelVoices voices;
+    return voices;
+}
+
+// time every audio callback and the voices in it (see MyApp::drawProfiler()
+// and --profile)
+static const bool PROFILE_AUDIO = true;
+
+// voices timed separately by the profiler
+enum ProfileKind
+{
+    PROFILE_MINISUB,
+    PROFILE_KPS,
+    PROFILE_FM,
+    NUM_PROFILE_KINDS
 };
 
-class Sequence
+static const char *const PROFILE_KIND_NAMES[NUM_PROFILE_KINDS] = {"MiniSubWaves", "KPSWaves", "FM"};
+
+AudioProfiler &profiler()
 {
-private:
-    TimeSignature ts;
-    std::vector<Note> notes;
+    static AudioProfiler profiler;
+    return profiler;
+}
 
-public:
-    Sequence(TimeSignature ts)
-    {
-        this->ts = ts;
-    }
+// offline bounce format, and how long to wait for the last notes to release
+static const double BOUNCE_SAMPLE_RATE = 48000.0;
+static const int BOUNCE_BLOCK = 512;
+static const float BOUNCE_MAX_TAIL = 10.0f;
 
-    void add(Note n)
-    {
-        notes.push_back(n);
-    }
+// --bench: seconds of audio each case renders per run
+static const float BENCH_SECONDS = 10.0f;
 
-    // Add notes from the source sequence s,
-    // but starting on the beat indicated by startBeat
+// the comb delay line is sized once for the lowest playable note
+// (the "frequency" parameter minimum) at up to this sample rate
+static const float COMB_LOWEST_FREQ = 20.0f;
+static const float COMB_MAX_SAMPLE_RATE = 96000.0f;
+// fractional delay interpolation used to tune the comb to the note
+static const CombInterp COMB_INTERP = COMB_LAGRANGE;
 
-    void addSequence(Sequence *s, float startBeat, float ampMult = 1.0)
-    {
-        for (auto &note : *(s->getNotes()))
-            add(Note(note, startBeat, ampMult));
-    }
+// https://en.wikipedia.org/wiki/Equal_temperament#General_formulas_for_the_equal-tempered_interval
+constexpr float note_freq(uint16_t note) { return MIDI_440[note]; }
+
+float detune(float freq, int cents) { return freq * centsToRatio((float)cents); }
+
+// The first GH phrases as compile-time data: note_freq() folds to each
+// frequency, so the notes are read-only constants with nothing to compute
+// at startup
+static constexpr Note GH_CHORDS_PHRASE1[] = {
+    Note(note_freq(Fs4), 0, 0.5, 0.3), Note(note_freq(B4), 0, 0.5, 0.3),
+    Note(note_freq(B4), 0.5, 0.5, 0.3), Note(note_freq(Fs5), 0.5, 0.5, 0.3),
+    Note(note_freq(Fs5), 1, 0.5, 0.3), Note(note_freq(Gs5), 1, 0.5, 0.3),
+    Note(note_freq(Gs5), 1.5, 0.5, 0.3), Note(note_freq(Ds6), 1.5, 0.5, 0.3),
+    Note(note_freq(Gs5), 2, 0.5, 0.3), Note(note_freq(Cs5), 2, 0.5, 0.3),
+};
 
-    std::vector<Note> *getNotes()
-    {
-        return &notes;
-    }
+static constexpr Note GH_BASS_PHRASE1[] = {
+    Note(note_freq(E3), 0, 0.5, 0.3),
+    Note(note_freq(B3), 0.5, 0.5, 0.3),
+    Note(note_freq(Gs3), 1, 1.0, 0.3),
+    Note(note_freq(Ds4), 2.5, 0.5, 0.3),
+    Note(note_freq(B3), 3, 0.5, 0.3),
+};
+
+// handles for the phrases built by MyApp::sequenceGH_*, cached in phrases()
+enum Phrase
+{
+    PHRASE_GH_CHORDS,
+    PHRASE_GH_BASS,
+    PHRASE_GH_CHORDS_1,
+    PHRASE_GH_BASS_1,
+    PHRASE_GH_2,
+    PHRASE_GH_3,
+    PHRASE_GH_4
+};
+
+PhraseCache &phrases()
+{
+    static PhraseCache cache;
+    return cache;
+}
+
+// Parameter block for KPSWaves, filled from cached parameter handles
+struct KPSWavesParams
+{
+    float amplitude = 0.3f;
+    float frequency = 60.0f;
+    float oscMix = 0.5f;
+    float noise = 0.0f;
+    float ampEnvAtk = 0.1f;
+    float ampEnvDec = 0.01f;
+    float ampEnvSus = 0.8f;
+    float ampEnvRel = 0.4f;
+    float ampEnvCve = 4.0f;
+    float filtEnvAtk = 0.1f;
+    float filtEnvDec = 0.01f;
+    float filtEnvSus = 0.8f;
+    float filtEnvRel = 0.4f;
+    float filtEnvCve = 4.0f;
+    float filtEnvDpth = 0.0f;
+    float filtFreq = 2400.0f;
+    float filtRes = 0.1f;
+    float combFbk = 0.5f;
+    float combFfw = 0.0f;
+    float combDec = 0.0f;
+    float combDamp = 0.0f; // loop lowpass, see FixedComb::damping()
+    float pluck = 0.0f; // seconds of excitation; 0 excites for the whole note
+    float pan = 0.0f;
 };
 
 class KPSWaves : public SynthVoice
@@ -154,12 +225,19 @@ public:
     gam::Pan<> mPan;
     gam::ADSR<> mAmpEnv;
     gam::ADSR<> mFiltEnv;
-    gam::EnvFollow<> mEnvFollow; // envelope follower to connect audio output to graphics
-    gam::Saw<> mOsc0;
-    gam::DWO<> mOsc1;
-    gam::NoiseWhite<> mNoise;
-    gam::Biquad<> mFilter;
-    gam::Comb<> mComb;
+    OutputMeter mMeter; // output level, to retire the voice and for graphics
+    WavetableOsc mOsc; // saw and square, read from wavetables()
+    BlockNoise mNoise; // generated NOISE_CHUNK samples at a time
+    BlockBiquad mFilter{FILTER_CTL_RATE}; // resonant LP, retuned at block rate
+    FixedComb mComb; // preallocated, never resized on the audio thread
+
+    // Parameters, read by the render loop without string lookups
+    ParamHandles<KPSWavesParams> mHandles;
+    KPSWavesParams mParams;
+    bool mPatched = false; // mParams came from applyPatch()
+    bool mReleased = false; // the note has been released, see silent()
+    ReleaseSplit mRelease; // frame of the next block to release on, see releaseAt()
+    int mExciteLeft = -1; // samples of pluck excitation to go; -1 while it never stops
 
     // Additional members
     Mesh mMesh;
@@ -175,64 +253,103 @@ public:
         mFiltEnv.levels(0, 1.0, 1.0, 0);
         mFiltEnv.sustainPoint(2);
 
-        // mComb.ipolType(ipl::ROUND);
+        mComb.capacity(1.0f / COMB_LOWEST_FREQ, COMB_MAX_SAMPLE_RATE);
+        mComb.ipolType(COMB_INTERP);
 
         // We have the mesh be a sphere
         addDisc(mMesh, 1.0, 30);
 
-        createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("oscMix", 0.5, 0.0, 1.0);
-        createInternalTriggerParameter("noise", 0.0, 0.0, 1.0);
-        createInternalTriggerParameter("ampEnvAtk", 0.1, 0.01, 2.0);
-        createInternalTriggerParameter("ampEnvDec", 0.01, 0.01, 2.0);
-        createInternalTriggerParameter("ampEnvSus", 0.8, 0.0, 1.0);
-        createInternalTriggerParameter("ampEnvRel", 0.4, 0.05, 2.0);
-        createInternalTriggerParameter("ampEnvCve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("filtEnvAtk", 0.1, 0.01, 2.0);
-        createInternalTriggerParameter("filtEnvDec", 0.01, 0.01, 2.0);
-        createInternalTriggerParameter("filtEnvSus", 0.8, 0.0, 1.0);
-        createInternalTriggerParameter("filtEnvRel", 0.4, 0.05, 2.0);
-        createInternalTriggerParameter("filtEnvCve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("filtEnvDpth", 0.0, -400, 4800);
-        createInternalTriggerParameter("filtFreq", 2400.0, 10.0, 5000);
-        createInternalTriggerParameter("filtRes", 0.1, 0.01, 10);
-        createInternalTriggerParameter("combDel", 0.002268, 0.001, 1.0);
-        createInternalTriggerParameter("combFbk", 0.5, -1.0, 1.0);
-        createInternalTriggerParameter("combFfw", 0.0, -1.0, 1.0);
-        createInternalTriggerParameter("combDec", 0.0, 0.001, 1.0);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+        mHandles.bind(&KPSWavesParams::amplitude, createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0));
+        mHandles.bind(&KPSWavesParams::frequency, createInternalTriggerParameter("frequency", 60, 20, 5000));
+        mHandles.bind(&KPSWavesParams::oscMix, createInternalTriggerParameter("oscMix", 0.5, 0.0, 1.0));
+        mHandles.bind(&KPSWavesParams::noise, createInternalTriggerParameter("noise", 0.0, 0.0, 1.0));
+        mHandles.bind(&KPSWavesParams::ampEnvAtk, createInternalTriggerParameter("ampEnvAtk", 0.1, 0.01, 2.0));
+        mHandles.bind(&KPSWavesParams::ampEnvDec, createInternalTriggerParameter("ampEnvDec", 0.01, 0.01, 2.0));
+        mHandles.bind(&KPSWavesParams::ampEnvSus, createInternalTriggerParameter("ampEnvSus", 0.8, 0.0, 1.0));
+        mHandles.bind(&KPSWavesParams::ampEnvRel, createInternalTriggerParameter("ampEnvRel", 0.4, 0.05, 2.0));
+        mHandles.bind(&KPSWavesParams::ampEnvCve, createInternalTriggerParameter("ampEnvCve", 4.0, -10.0, 10.0));
+        mHandles.bind(&KPSWavesParams::filtEnvAtk, createInternalTriggerParameter("filtEnvAtk", 0.1, 0.01, 2.0));
+        mHandles.bind(&KPSWavesParams::filtEnvDec, createInternalTriggerParameter("filtEnvDec", 0.01, 0.01, 2.0));
+        mHandles.bind(&KPSWavesParams::filtEnvSus, createInternalTriggerParameter("filtEnvSus", 0.8, 0.0, 1.0));
+        mHandles.bind(&KPSWavesParams::filtEnvRel, createInternalTriggerParameter("filtEnvRel", 0.4, 0.05, 2.0));
+        mHandles.bind(&KPSWavesParams::filtEnvCve, createInternalTriggerParameter("filtEnvCve", 4.0, -10.0, 10.0));
+        mHandles.bind(&KPSWavesParams::filtEnvDpth, createInternalTriggerParameter("filtEnvDpth", 0.0, -400, 4800));
+        mHandles.bind(&KPSWavesParams::filtFreq, createInternalTriggerParameter("filtFreq", 2400.0, 10.0, 5000));
+        mHandles.bind(&KPSWavesParams::filtRes, createInternalTriggerParameter("filtRes", 0.1, 0.01, 10));
+        mHandles.bind(&KPSWavesParams::combFbk, createInternalTriggerParameter("combFbk", 0.5, -1.0, 1.0));
+        mHandles.bind(&KPSWavesParams::combFfw, createInternalTriggerParameter("combFfw", 0.0, -1.0, 1.0));
+        mHandles.bind(&KPSWavesParams::combDec, createInternalTriggerParameter("combDec", 0.0, 0.001, 1.0));
+        mHandles.bind(&KPSWavesParams::combDamp, createInternalTriggerParameter("combDamp", 0.0, 0.0, 0.99));
+        mHandles.bind(&KPSWavesParams::pluck, createInternalTriggerParameter("pluck", 0.0, 0.0, 0.1));
+        mHandles.bind(&KPSWavesParams::pan, createInternalTriggerParameter("pan", 0.0, -1.0, 1.0));
     }
 
     //
 
     virtual void onProcess(AudioIOData &io) override
     {
+        profiler().countVoice(PROFILE_KPS);
+        if (silent())
+        {
+            free(); // retire without rendering another block
+            return;
+        }
+        if (!parallelVoices().defer(this, io))
+            renderAudio(io);
+    }
+
+    // Nothing left to hear: the envelope has finished, or the note is
+    // released and its envelope and last block are both below RETIRE_LEVEL,
+    // or a pluck has rung down so far that it would stay below RETIRE_LEVEL
+    // even with the envelope fully open
+    bool silent() const
+    {
+        if (mAmpEnv.done())
+            return true;
+        if (mExciteLeft == 0 && mMeter.peak() < RETIRE_LEVEL * mAmpEnv.value())
+            return true;
+        return mReleased && mAmpEnv.value() * mParams.amplitude < RETIRE_LEVEL && mMeter.peak() < RETIRE_LEVEL;
+    }
+
+    // Render this block, on the audio thread or a render pool thread
+    void renderAudio(AudioIOData &io)
+    {
+        ProfileTimer timer(profiler(), PROFILE_KPS);
+        NoAllocScope noAlloc; // changing the comb delay must never touch the heap
         updateFromParameters();
-        float amp = getInternalParameterValue("amplitude");
-        float filtFreq = getInternalParameterValue("filtFreq");
-        float filtEnvDepth = getInternalParameterValue("filtEnvDpth");
-        float oscMix = getInternalParameterValue("oscMix");
-        float noiseMix = getInternalParameterValue("noise");
-        float noteFreq = getInternalParameterValue("frequency");
-        
+        float amp = mParams.amplitude;
+        float filtFreq = mParams.filtFreq;
+        float filtEnvDepth = mParams.filtEnvDpth;
+        float oscMix = mParams.oscMix;
+        float noiseMix = mParams.noise;
+
+        mRelease.beginBlock();
         while (io())
         {
-            // mix oscillator with noise
-            float osc0 = mOsc0();
-            float osc1 = mOsc1.sqr();
-            float mainOscMix = osc0 * (1 - oscMix) + osc1 * (oscMix);
-            float noiseSamp = mNoise() * noiseMix;
-            float s1 = mainOscMix * (1 - noiseMix) + noiseSamp;
-
-            // apply main filter
-            mFilter.freq(filtFreq + (mFiltEnv() * filtEnvDepth));
-            s1 = mFilter(s1);
-            mComb.delay((44100.0 / noteFreq) / 44100.0);
+            if (mRelease.due(io.frame()))
+                onTriggerOff(); // split the block at the release
+
+            // excite the string; once a pluck is over only the comb loop runs
+            float s1 = 0.0f;
+            if (mExciteLeft != 0)
+            {
+                if (mExciteLeft > 0)
+                    mExciteLeft--;
+
+                // mix oscillator with noise
+                float mainOscMix = mOsc.mix(oscMix);
+                float noiseSamp = mNoise() * noiseMix;
+                s1 = mainOscMix * (1 - noiseMix) + noiseSamp;
+
+                // apply main filter
+                mFilter.freq(filtFreq + (mFiltEnv() * filtEnvDepth));
+                s1 = mFilter(s1);
+            }
             s1 = mComb(s1);
 
             // apply amplitude envelope
             s1 *= mAmpEnv() * amp;
+            mMeter(s1);
 
             float s2;
             mPan(s1, s1, s2);
@@ -240,77 +357,158 @@ public:
             io.out(1) += s2;
         }
 
-        if (mAmpEnv.done() && (mEnvFollow.value() < 0.001f))
-            free();
+        mMeter.endBlock();
     }
 
     virtual void onProcess(Graphics &g)
     {
-        float frequency = getInternalParameterValue("frequency");
-        float amplitude = getInternalParameterValue("amplitude");
+        float frequency = mParams.frequency;
+        float amplitude = mParams.amplitude;
         g.pushMatrix();
         g.translate(amplitude, amplitude, -4);
         //g.scale(frequency/2000, frequency/4000, 1);
         float scaling = 0.1;
         g.scale(scaling * frequency / 200, scaling * frequency / 400, scaling * 1);
-        g.color(mEnvFollow.value(), frequency / 1000, mEnvFollow.value() * 10, 0.4);
+        g.color(mMeter.rms(), frequency / 1000, mMeter.rms() * 10, 0.4);
         g.draw(mMesh);
         g.popMatrix();
     }
+    // Take every parameter from a precompiled patch (see PatchRegistry)
+    // with one copy. The voice ignores its Parameters until it is freed.
+    void applyPatch(const KPSWavesParams &patch, float amp, float freq)
+    {
+        mParams = patch;
+        mParams.amplitude = amp;
+        mParams.frequency = freq;
+        mPatched = true;
+    }
+
+    void onFree() override { mPatched = false; }
+
+    // Release the note offset frames into the next block rendered, instead
+    // of at its start
+    void releaseAt(int offset) { mRelease.at(offset); }
+
+    // Current output level, to choose which note to steal. A finished
+    // pluck fades with its string, not its envelope, so it is measured.
+    float level() const
+    {
+        if (mExciteLeft == 0)
+            return mMeter.peak();
+        return mAmpEnv.value() * mParams.amplitude;
+    }
+
+    // Fade out over STEAL_RELEASE seconds so the note's place can be reused
+    void steal()
+    {
+        mParams.ampEnvRel = mParams.filtEnvRel = STEAL_RELEASE;
+        mAmpEnv.release(STEAL_RELEASE);
+        mFiltEnv.release(STEAL_RELEASE);
+        onTriggerOff();
+    }
+
     virtual void onTriggerOn() override
     {
+        mRelease.clear();
+        mReleased = false;
+        mMeter.reset();
+        noiseStreams().next(mNoise);
+        mFilter.sampleRate(gam::sampleRate());
+        mFilter.reset();
+        mComb.sampleRate(gam::sampleRate());
+        mComb.reset();
         updateFromParameters();
         mAmpEnv.reset();
         mFiltEnv.reset();
+
+        mExciteLeft = -1;
+        if (mParams.pluck > 0.0f)
+            mExciteLeft = std::max(1, (int)std::lround(mParams.pluck * gam::sampleRate()));
     }
 
     virtual void onTriggerOff() override
     {
+        mReleased = true;
         mAmpEnv.triggerRelease();
         mFiltEnv.triggerRelease();
     }
 
     void updateFromParameters()
     {
-        mOsc0.freq(getInternalParameterValue("frequency"));
-        mOsc1.freq(getInternalParameterValue("frequency"));
-
-        mAmpEnv.attack(getInternalParameterValue("ampEnvAtk"));
-        mAmpEnv.decay(getInternalParameterValue("ampEnvDec"));
-        mAmpEnv.sustain(getInternalParameterValue("ampEnvSus"));
-        mAmpEnv.release(getInternalParameterValue("ampEnvRel"));
-        mAmpEnv.curve(getInternalParameterValue("ampEnvCve"));
-
-        mPan.pos(getInternalParameterValue("pan"));
-
-        mFilter.freq(getInternalParameterValue("filtFreq"));
-        mFilter.res(getInternalParameterValue("filtRes"));
-
-        mFiltEnv.attack(getInternalParameterValue("filtEnvAtk"));
-        mFiltEnv.decay(getInternalParameterValue("filtEnvDec"));
-        mFiltEnv.sustain(getInternalParameterValue("filtEnvSus"));
-        mFiltEnv.release(getInternalParameterValue("filtEnvRel"));
-        mFiltEnv.curve(getInternalParameterValue("filtEnvCve"));
-
-        mComb.maxDelay(getInternalParameterValue("combDel") * 1.1);
-        mComb.delay(getInternalParameterValue("combDel"));
-        mComb.ffd(getInternalParameterValue("combFfw"));
-        mComb.fbk(getInternalParameterValue("combFbk"));
-        mComb.decay(getInternalParameterValue("combDec"));
+        if (!mPatched)
+            mHandles.pull(mParams);
+
+        mOsc.freq(wavetables(), mParams.frequency);
+
+        mAmpEnv.attack(mParams.ampEnvAtk);
+        mAmpEnv.decay(mParams.ampEnvDec);
+        mAmpEnv.sustain(mParams.ampEnvSus);
+        mAmpEnv.release(mParams.ampEnvRel);
+        mAmpEnv.curve(mParams.ampEnvCve);
+
+        mPan.pos(mParams.pan);
+
+        mFilter.freq(mParams.filtFreq);
+        mFilter.res(mParams.filtRes);
+
+        mFiltEnv.attack(mParams.filtEnvAtk);
+        mFiltEnv.decay(mParams.filtEnvDec);
+        mFiltEnv.sustain(mParams.filtEnvSus);
+        mFiltEnv.release(mParams.filtEnvRel);
+        mFiltEnv.curve(mParams.filtEnvCve);
+
+        // track the note: one period of delay at the real sample rate, set
+        // before decay() so the feedback rings for combDec at this pitch
+        mComb.damping(mParams.combDamp);
+        mComb.delaySamples(gam::sampleRate() / mParams.frequency);
+        mComb.ffd(mParams.combFfw);
+        mComb.fbk(mParams.combFbk);
+        mComb.decay(mParams.combDec);
     }
 };
 
 
+// Parameter block for FM, filled from cached parameter handles
+struct FMParams
+{
+    float amplitude = 0.5f;
+    float freq = 440.0f;
+    float attackTime = 0.1f;
+    float releaseTime = 0.1f;
+    float pan = 0.0f;
+    float idx1 = 0.01f;
+    float idx2 = 7.0f;
+    float idx3 = 5.0f;
+    float carMul = 1.0f;
+    float modMul = 1.0007f;
+    float sustain = 0.75f;
+};
+
 class FM : public SynthVoice
 {
 public:
     // Unit generators
     gam::Pan<> mPan;
     gam::ADSR<> mAmpEnv;
-    gam::ADSR<> mModEnv;
-    gam::EnvFollow<> mEnvFollow;
+    gam::ADSR<> mModEnv; // modulation index, stepped once per FM_BLOCK samples
+    OutputMeter mMeter; // output level, to retire the voice and for graphics
 
-    gam::Sine<> car, mod; // carrier, modulator sine oscillators
+    // carrier and modulator as phase modulation operators (FM_PAIR)
+    enum
+    {
+        CARRIER,
+        MODULATOR
+    };
+    FMOperators mOps;
+    float mBlock[FM_BLOCK]; // rendered by mOps, handed out a sample at a time
+    int mNext = FM_BLOCK;
+
+    // Parameters, read by the render loop without string lookups
+    ParamHandles<FMParams> mHandles;
+    FMParams mParams;
+    bool mPatched = false; // mParams came from applyPatch()
+    bool mReleased = false; // the note has been released, see silent()
+    ReleaseSplit mRelease; // frame of the next block to release on, see releaseAt()
 
     // Additional members
     Mesh mMesh;
@@ -319,93 +517,185 @@ public:
     {
         //      mAmpEnv.curve(0); // linear segments
         mAmpEnv.levels(0, 1, 1, 0);
+        mOps.level(CARRIER, 1.0f);
 
         // We have the mesh be a sphere
         addDisc(mMesh, 1.0, 30);
 
-        createInternalTriggerParameter("amplitude", 0.5, 0.0, 1.0);
-        createInternalTriggerParameter("freq", 440, 10, 4000.0);
-        createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-        createInternalTriggerParameter("releaseTime", 0.1, 0.1, 10.0);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+        mHandles.bind(&FMParams::amplitude, createInternalTriggerParameter("amplitude", 0.5, 0.0, 1.0));
+        mHandles.bind(&FMParams::freq, createInternalTriggerParameter("freq", 440, 10, 4000.0));
+        mHandles.bind(&FMParams::attackTime, createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0));
+        mHandles.bind(&FMParams::releaseTime, createInternalTriggerParameter("releaseTime", 0.1, 0.1, 10.0));
+        mHandles.bind(&FMParams::pan, createInternalTriggerParameter("pan", 0.0, -1.0, 1.0));
 
         // FM index
-        createInternalTriggerParameter("idx1", 0.01, 0.0, 10.0);
-        createInternalTriggerParameter("idx2", 7, 0.0, 10.0);
-        createInternalTriggerParameter("idx3", 5, 0.0, 10.0);
+        mHandles.bind(&FMParams::idx1, createInternalTriggerParameter("idx1", 0.01, 0.0, 10.0));
+        mHandles.bind(&FMParams::idx2, createInternalTriggerParameter("idx2", 7, 0.0, 10.0));
+        mHandles.bind(&FMParams::idx3, createInternalTriggerParameter("idx3", 5, 0.0, 10.0));
 
-        createInternalTriggerParameter("carMul", 1, 0.0, 20.0);
-        createInternalTriggerParameter("modMul", 1.0007, 0.0, 20.0);
-        createInternalTriggerParameter("sustain", 0.75, 0.1, 1.0); // Unused
+        mHandles.bind(&FMParams::carMul, createInternalTriggerParameter("carMul", 1, 0.0, 20.0));
+        mHandles.bind(&FMParams::modMul, createInternalTriggerParameter("modMul", 1.0007, 0.0, 20.0));
+        mHandles.bind(&FMParams::sustain, createInternalTriggerParameter("sustain", 0.75, 0.1, 1.0)); // Unused
     }
 
     //
     void onProcess(AudioIOData &io) override
     {
-        float modFreq =
-            getInternalParameterValue("freq") * getInternalParameterValue("modMul");
-        mod.freq(modFreq);
-        float carBaseFreq =
-            getInternalParameterValue("freq") * getInternalParameterValue("carMul");
-        float modScale =
-            getInternalParameterValue("freq") * getInternalParameterValue("modMul");
-        float amp = getInternalParameterValue("amplitude");
+        profiler().countVoice(PROFILE_FM);
+        if (silent())
+        {
+            free(); // retire without rendering another block
+            return;
+        }
+        if (!parallelVoices().defer(this, io))
+            renderAudio(io);
+    }
+
+    // Nothing left to hear: the envelope has finished, or the note is
+    // released and its envelope and last block are both below RETIRE_LEVEL
+    bool silent() const
+    {
+        if (mAmpEnv.done())
+            return true;
+        return mReleased && mAmpEnv.value() * mParams.amplitude < RETIRE_LEVEL && mMeter.peak() < RETIRE_LEVEL;
+    }
+
+    // Render this block, on the audio thread or a render pool thread
+    void renderAudio(AudioIOData &io)
+    {
+        ProfileTimer timer(profiler(), PROFILE_FM);
+        if (!mPatched)
+            mHandles.pull(mParams);
+        mOps.freq(CARRIER, mParams.freq * mParams.carMul);
+        mOps.freq(MODULATOR, mParams.freq * mParams.modMul);
+        float amp = mParams.amplitude;
+        mRelease.beginBlock();
         while (io())
         {
-            car.freq(carBaseFreq + mod() * mModEnv() * modScale);
-            float s1 = car() * mAmpEnv() * amp;
+            if (mRelease.due(io.frame()))
+                onTriggerOff(); // split the block at the release
+
+            if (mNext == FM_BLOCK)
+            {
+                mOps.level(MODULATOR, mModEnv());
+                mOps.render(mBlock);
+                mNext = 0;
+            }
+            float s1 = mBlock[mNext++] * mAmpEnv() * amp;
             float s2;
-            mEnvFollow(s1);
+            mMeter(s1);
             mPan(s1, s1, s2);
             io.out(0) += s1;
             io.out(1) += s2;
         }
-        if (mAmpEnv.done() && (mEnvFollow.value() < 0.001))
-            free();
+        mMeter.endBlock();
     }
 
     void onProcess(Graphics &g) override
     {
         g.pushMatrix();
-        g.translate(getInternalParameterValue("freq") / 300 - 2,
+        g.translate(mParams.freq / 300 - 2,
                     getInternalParameterValue("modAmt") / 25 - 1, -4);
-        float scaling = getInternalParameterValue("amplitude") * 1;
+        float scaling = mParams.amplitude * 1;
         g.scale(scaling, scaling, scaling * 1);
-        g.color(HSV(getInternalParameterValue("modMul") / 20, 1,
-                    mEnvFollow.value() * 10));
+        g.color(HSV(mParams.modMul / 20, 1,
+                    mMeter.rms() * 10));
         g.draw(mMesh);
         g.popMatrix();
     }
 
-    void onTriggerOn() override
+    // Take every parameter from a precompiled patch (see PatchRegistry)
+    // with one copy. The voice ignores its Parameters until it is freed.
+    void applyPatch(const FMParams &patch, float amp, float freq)
+    {
+        mParams = patch;
+        mParams.amplitude = amp;
+        mParams.freq = freq;
+        mPatched = true;
+    }
+
+    void onFree() override { mPatched = false; }
+
+    // Release the note offset frames into the next block rendered, instead
+    // of at its start
+    void releaseAt(int offset) { mRelease.at(offset); }
+
+    // Current output level, to choose which note to steal
+    float level() const { return mAmpEnv.value() * mParams.amplitude; }
+
+    // Fade out over STEAL_RELEASE seconds so the note's place can be reused
+    void steal()
     {
-        mModEnv.levels()[0] = getInternalParameterValue("idx1");
-        mModEnv.levels()[1] = getInternalParameterValue("idx2");
-        mModEnv.levels()[2] = getInternalParameterValue("idx2");
-        mModEnv.levels()[3] = getInternalParameterValue("idx3");
+        mParams.releaseTime = STEAL_RELEASE;
+        mAmpEnv.lengths()[2] = STEAL_RELEASE;
+        mModEnv.lengths()[2] = STEAL_RELEASE / FM_BLOCK;
+        onTriggerOff();
+    }
 
-        mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
-        mModEnv.lengths()[0] = getInternalParameterValue("attackTime");
+    void onTriggerOn() override
+    {
+        mRelease.clear();
+        mReleased = false;
+        mMeter.reset();
+        if (!mPatched)
+            mHandles.pull(mParams);
+        mModEnv.levels()[0] = mParams.idx1;
+        mModEnv.levels()[1] = mParams.idx2;
+        mModEnv.levels()[2] = mParams.idx2;
+        mModEnv.levels()[3] = mParams.idx3;
+
+        // mModEnv is called once per FM_BLOCK samples, so its segments
+        // are that many times shorter
+        mAmpEnv.lengths()[0] = mParams.attackTime;
+        mModEnv.lengths()[0] = mParams.attackTime / FM_BLOCK;
 
         mAmpEnv.lengths()[1] = 0.001;
-        mModEnv.lengths()[1] = 0.001;
+        mModEnv.lengths()[1] = 0.001 / FM_BLOCK;
 
-        mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
-        mModEnv.lengths()[2] = getInternalParameterValue("releaseTime");
-        mPan.pos(getInternalParameterValue("pan"));
+        mAmpEnv.lengths()[2] = mParams.releaseTime;
+        mModEnv.lengths()[2] = mParams.releaseTime / FM_BLOCK;
+        mPan.pos(mParams.pan);
 
         //        mModEnv.lengths()[1] = mAmpEnv.lengths()[1];
 
         mAmpEnv.reset();
         mModEnv.reset();
+        mOps.sampleRate(gam::sampleRate());
+        mOps.level(MODULATOR, mParams.idx1);
+        mOps.reset();
+        mNext = FM_BLOCK;
     }
     void onTriggerOff() override
     {
+        mReleased = true;
         mAmpEnv.triggerRelease();
         mModEnv.triggerRelease();
     }
 };
 
+// Parameter block for MiniSubWaves, filled from cached parameter handles
+struct MiniSubWavesParams
+{
+    float amplitude = 0.3f;
+    float frequency = 60.0f;
+    float oscMix = 0.5f;
+    float noise = 0.0f;
+    float ampEnvAtk = 0.1f;
+    float ampEnvDec = 0.01f;
+    float ampEnvSus = 0.8f;
+    float ampEnvRel = 0.4f;
+    float ampEnvCve = 4.0f;
+    float filtEnvAtk = 0.1f;
+    float filtEnvDec = 0.01f;
+    float filtEnvSus = 0.8f;
+    float filtEnvRel = 0.4f;
+    float filtEnvCve = 4.0f;
+    float filtEnvDpth = 0.0f;
+    float filtFreq = 2400.0f;
+    float filtRes = 0.1f;
+    float pan = 0.0f;
+};
+
 class MiniSubWaves : public SynthVoice
 {
 public:
@@ -414,11 +704,24 @@ public:
     gam::Pan<> mPan;
     gam::ADSR<> mAmpEnv;
     gam::ADSR<> mFiltEnv;
-    gam::EnvFollow<> mEnvFollow; // envelope follower to connect audio output to graphics
-    gam::Saw<> mOsc0;
-    gam::DWO<> mOsc1;
-    gam::NoiseWhite<> mNoise;
-    gam::Biquad<> mFilter;
+    OutputMeter mMeter; // output level, to retire the voice and for graphics
+    WavetableOsc mOsc; // saw and square, read from wavetables()
+    BlockNoise mNoise; // generated NOISE_CHUNK samples at a time
+    BlockBiquad mFilter{FILTER_CTL_RATE}; // resonant LP, retuned at block rate
+
+    // Parameters, read by the render loop without string lookups
+    ParamHandles<MiniSubWavesParams> mHandles;
+    MiniSubWavesParams mParams;
+    bool mPatched = false; // mParams came from applyPatch()
+    bool mReleased = false; // the note has been released, see silent()
+    ReleaseSplit mRelease; // frame of the next block to release on, see releaseAt()
+
+    // lane in miniSubBank() while a note is playing there, -1 to render here.
+    // Set on the audio thread and read by onProcess(Graphics &), so each
+    // reader loads it once.
+    std::atomic<int> mLane{-1};
+    bool mLaneStarted = false;
+
     // Additional members
     Mesh mMesh;
 
@@ -436,42 +739,88 @@ public:
         // We have the mesh be a sphere
         addDisc(mMesh, 1.0, 30);
 
-        createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("oscMix", 0.5, 0.0, 1.0);
-        createInternalTriggerParameter("noise", 0.0, 0.0, 1.0);
-        createInternalTriggerParameter("ampEnvAtk", 0.1, 0.01, 2.0);
-        createInternalTriggerParameter("ampEnvDec", 0.01, 0.01, 2.0);
-        createInternalTriggerParameter("ampEnvSus", 0.8, 0.0, 1.0);
-        createInternalTriggerParameter("ampEnvRel", 0.4, 0.05, 2.0);
-        createInternalTriggerParameter("ampEnvCve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("filtEnvAtk", 0.1, 0.01, 2.0);
-        createInternalTriggerParameter("filtEnvDec", 0.01, 0.01, 2.0);
-        createInternalTriggerParameter("filtEnvSus", 0.8, 0.0, 1.0);
-        createInternalTriggerParameter("filtEnvRel", 0.4, 0.05, 2.0);
-        createInternalTriggerParameter("filtEnvCve", 4.0, -10.0, 10.0);
-        createInternalTriggerParameter("filtEnvDpth", 0.0, -400, 4800);
-        createInternalTriggerParameter("filtFreq", 2400.0, 10.0, 5000);
-        createInternalTriggerParameter("filtRes", 0.1, 0.01, 10);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+        mHandles.bind(&MiniSubWavesParams::amplitude, createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::frequency, createInternalTriggerParameter("frequency", 60, 20, 5000));
+        mHandles.bind(&MiniSubWavesParams::oscMix, createInternalTriggerParameter("oscMix", 0.5, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::noise, createInternalTriggerParameter("noise", 0.0, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvAtk, createInternalTriggerParameter("ampEnvAtk", 0.1, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvDec, createInternalTriggerParameter("ampEnvDec", 0.01, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvSus, createInternalTriggerParameter("ampEnvSus", 0.8, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvRel, createInternalTriggerParameter("ampEnvRel", 0.4, 0.05, 2.0));
+        mHandles.bind(&MiniSubWavesParams::ampEnvCve, createInternalTriggerParameter("ampEnvCve", 4.0, -10.0, 10.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvAtk, createInternalTriggerParameter("filtEnvAtk", 0.1, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvDec, createInternalTriggerParameter("filtEnvDec", 0.01, 0.01, 2.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvSus, createInternalTriggerParameter("filtEnvSus", 0.8, 0.0, 1.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvRel, createInternalTriggerParameter("filtEnvRel", 0.4, 0.05, 2.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvCve, createInternalTriggerParameter("filtEnvCve", 4.0, -10.0, 10.0));
+        mHandles.bind(&MiniSubWavesParams::filtEnvDpth, createInternalTriggerParameter("filtEnvDpth", 0.0, -400, 4800));
+        mHandles.bind(&MiniSubWavesParams::filtFreq, createInternalTriggerParameter("filtFreq", 2400.0, 10.0, 5000));
+        mHandles.bind(&MiniSubWavesParams::filtRes, createInternalTriggerParameter("filtRes", 0.1, 0.01, 10));
+        mHandles.bind(&MiniSubWavesParams::pan, createInternalTriggerParameter("pan", 0.0, -1.0, 1.0));
     }
 
     //
 
     virtual void onProcess(AudioIOData &io) override
     {
+        profiler().countVoice(PROFILE_MINISUB);
+        int lane = mLane.load(std::memory_order_relaxed);
+        if (lane >= 0)
+        {
+            // the bank renders this note; just place its start and retire it
+            if (!mLaneStarted)
+            {
+                miniSubBank().startAt(lane, io.frame() + 1); // frame() is one before the first
+                mLaneStarted = true;
+            }
+            else if (miniSubBank().done(lane) || laneSilent(lane))
+            {
+                miniSubBank().release(lane);
+                mLane.store(-1, std::memory_order_relaxed);
+                free();
+            }
+            return;
+        }
+
+        if (silent())
+        {
+            free(); // retire without rendering another block
+            return;
+        }
+        if (!parallelVoices().defer(this, io))
+            renderAudio(io);
+    }
+
+    // A bank note past its release whose lane has faded below RETIRE_LEVEL
+    static bool laneSilent(int lane) { return miniSubBank().released(lane) && miniSubBank().level(lane) < RETIRE_LEVEL; }
+
+    // Nothing left to hear: the envelope has finished, or the note is
+    // released and its envelope and last block are both below RETIRE_LEVEL
+    bool silent() const
+    {
+        if (mAmpEnv.done())
+            return true;
+        return mReleased && mAmpEnv.value() * mParams.amplitude < RETIRE_LEVEL && mMeter.peak() < RETIRE_LEVEL;
+    }
+
+    // Render this block, on the audio thread or a render pool thread
+    void renderAudio(AudioIOData &io)
+    {
+        ProfileTimer timer(profiler(), PROFILE_MINISUB);
         updateFromParameters();
-        float amp = getInternalParameterValue("amplitude");
-        float filtFreq = getInternalParameterValue("filtFreq");
-        float filtEnvDepth = getInternalParameterValue("filtEnvDpth");
-        float oscMix = getInternalParameterValue("oscMix");
-        float noiseMix = getInternalParameterValue("noise");
+        float amp = mParams.amplitude;
+        float filtFreq = mParams.filtFreq;
+        float filtEnvDepth = mParams.filtEnvDpth;
+        float oscMix = mParams.oscMix;
+        float noiseMix = mParams.noise;
+        mRelease.beginBlock();
         while (io())
         {
+            if (mRelease.due(io.frame()))
+                onTriggerOff(); // split the block at the release
+
             // mix oscillator with noise
-            float osc0 = mOsc0();
-            float osc1 = mOsc1.sqr();
-            float mainOscMix = osc0 * (1 - oscMix) + osc1 * (oscMix);
+            float mainOscMix = mOsc.mix(oscMix);
             float noiseSamp = mNoise() * noiseMix;
             float s1 = mainOscMix * (1 - noiseMix) + noiseSamp;
 
@@ -481,6 +830,7 @@ public:
 
             // apply amplitude envelope
             s1 *= mAmpEnv() * amp;
+            mMeter(s1);
 
             float s2;
             mPan(s1, s1, s2);
@@ -488,60 +838,259 @@ public:
             io.out(1) += s2;
         }
 
-        if (mAmpEnv.done() && (mEnvFollow.value() < 0.001f))
-            free();
+        mMeter.endBlock();
     }
 
     virtual void onProcess(Graphics &g)
     {
-        float frequency = getInternalParameterValue("frequency");
-        float amplitude = getInternalParameterValue("amplitude");
+        float frequency = mParams.frequency;
+        float amplitude = mParams.amplitude;
         g.pushMatrix();
         g.translate(amplitude, amplitude, -4);
         //g.scale(frequency/2000, frequency/4000, 1);
         float scaling = 0.1;
         g.scale(scaling * frequency / 200, scaling * frequency / 400, scaling * 1);
-        g.color(mEnvFollow.value(), frequency / 1000, mEnvFollow.value() * 10, 0.4);
+        int lane = mLane.load(std::memory_order_relaxed);
+        float level = lane >= 0 ? miniSubBank().level(lane) : mMeter.rms();
+        g.color(level, frequency / 1000, level * 10, 0.4);
         g.draw(mMesh);
         g.popMatrix();
     }
+    // Take every parameter from a precompiled patch (see PatchRegistry)
+    // with one copy. The voice ignores its Parameters until it is freed.
+    void applyPatch(const MiniSubWavesParams &patch, float amp, float freq)
+    {
+        mParams = patch;
+        mParams.amplitude = amp;
+        mParams.frequency = freq;
+        mPatched = true;
+    }
+
+    void onFree() override { mPatched = false; }
+
+    // Release the note offset frames into the next block rendered, instead
+    // of at its start
+    void releaseAt(int offset)
+    {
+        int lane = mLane.load(std::memory_order_relaxed);
+        if (lane >= 0)
+            miniSubBank().noteOffAt(lane, offset);
+        else
+            mRelease.at(offset);
+    }
+
+    // Current output level, to choose which note to steal
+    float level()
+    {
+        int lane = mLane.load(std::memory_order_relaxed);
+        if (lane >= 0)
+            return miniSubBank().level(lane);
+        return mAmpEnv.value() * mParams.amplitude;
+    }
+
+    // Fade out over STEAL_RELEASE seconds so the note's place can be reused
+    void steal()
+    {
+        mParams.ampEnvRel = mParams.filtEnvRel = STEAL_RELEASE;
+        mAmpEnv.release(STEAL_RELEASE);
+        mFiltEnv.release(STEAL_RELEASE);
+        int lane = mLane.load(std::memory_order_relaxed);
+        if (lane >= 0)
+            miniSubBank().fadeOut(lane, STEAL_RELEASE);
+        else
+            onTriggerOff();
+    }
+
     virtual void onTriggerOn() override
     {
+        mRelease.clear();
+        mReleased = false;
+        mMeter.reset();
+        noiseStreams().next(mNoise);
+        mFilter.sampleRate(gam::sampleRate());
+        mFilter.reset();
         updateFromParameters();
         mAmpEnv.reset();
         mFiltEnv.reset();
+
+        if (MINISUB_USE_BANK)
+        {
+            int lane = mLane.load(std::memory_order_relaxed);
+            if (lane < 0)
+            {
+                lane = miniSubBank().acquire(); // -1 if full: render here instead
+                mLane.store(lane, std::memory_order_relaxed);
+            }
+            if (lane >= 0)
+            {
+                miniSubBank().noteOn(lane, mParams, wavetables());
+                mLaneStarted = false;
+            }
+        }
     }
 
     virtual void onTriggerOff() override
     {
+        mReleased = true;
         mAmpEnv.triggerRelease();
         mFiltEnv.triggerRelease();
+        int lane = mLane.load(std::memory_order_relaxed);
+        if (lane >= 0)
+            miniSubBank().noteOff(lane);
     }
 
     void updateFromParameters()
     {
-        mOsc0.freq(getInternalParameterValue("frequency"));
-        mOsc1.freq(getInternalParameterValue("frequency"));
+        if (!mPatched)
+            mHandles.pull(mParams);
+
+        mOsc.freq(wavetables(), mParams.frequency);
+
+        mAmpEnv.attack(mParams.ampEnvAtk);
+        mAmpEnv.decay(mParams.ampEnvDec);
+        mAmpEnv.sustain(mParams.ampEnvSus);
+        mAmpEnv.release(mParams.ampEnvRel);
+        mAmpEnv.curve(mParams.ampEnvCve);
+
+        mPan.pos(mParams.pan);
 
-        mAmpEnv.attack(getInternalParameterValue("ampEnvAtk"));
-        mAmpEnv.decay(getInternalParameterValue("ampEnvDec"));
-        mAmpEnv.sustain(getInternalParameterValue("ampEnvSus"));
-        mAmpEnv.release(getInternalParameterValue("ampEnvRel"));
-        mAmpEnv.curve(getInternalParameterValue("ampEnvCve"));
+        mFilter.freq(mParams.filtFreq);
+        mFilter.res(mParams.filtRes);
 
-        mPan.pos(getInternalParameterValue("pan"));
+        mFiltEnv.attack(mParams.filtEnvAtk);
+        mFiltEnv.decay(mParams.filtEnvDec);
+        mFiltEnv.sustain(mParams.filtEnvSus);
+        mFiltEnv.release(mParams.filtEnvRel);
+        mFiltEnv.curve(mParams.filtEnvCve);
+    }
+};
 
-        mFilter.freq(getInternalParameterValue("filtFreq"));
-        mFilter.res(getInternalParameterValue("filtRes"));
+// Instrument presets, compiled once into parameter snapshots. playNote
+// copies one into a pooled voice instead of setting each parameter by name.
+// Fields a preset doesn't mention keep the Parameter defaults.
+struct PatchRegistry
+{
+    MiniSubWavesParams miniSub[NUM_INSTRUMENTS];
+    KPSWavesParams kps[NUM_INSTRUMENTS];
+    FMParams fm[NUM_INSTRUMENTS];
 
-        mFiltEnv.attack(getInternalParameterValue("filtEnvAtk"));
-        mFiltEnv.decay(getInternalParameterValue("filtEnvDec"));
-        mFiltEnv.sustain(getInternalParameterValue("filtEnvSus"));
-        mFiltEnv.release(getInternalParameterValue("filtEnvRel"));
-        mFiltEnv.curve(getInternalParameterValue("filtEnvCve"));
+    PatchRegistry()
+    {
+        MiniSubWavesParams &chords = miniSub[INSTR_MSCHORDS];
+        chords.oscMix = 0.1f;
+        chords.ampEnvAtk = 0.1f;
+        chords.ampEnvDec = 0.3f;
+        chords.ampEnvSus = 0.6f;
+        chords.ampEnvRel = 0.2f;
+        chords.filtEnvAtk = 0.25f;
+        chords.filtEnvDec = 0.2f;
+        chords.filtEnvSus = 0.05f;
+        chords.filtEnvRel = 0.1f;
+        chords.filtEnvDpth = 1800.0f;
+        chords.filtEnvCve = 1.0f;
+        chords.filtFreq = 1150.0f;
+        chords.filtRes = 1.0f;
+        chords.pan = 0.0f;
+
+        MiniSubWavesParams &bass = miniSub[INSTR_MSBASS];
+        bass.oscMix = 0.7f;
+        bass.ampEnvAtk = 0.01f;
+        bass.ampEnvDec = 0.35f;
+        bass.ampEnvSus = 0.6f;
+        bass.ampEnvRel = 0.2f;
+        bass.filtEnvAtk = 0.05f;
+        bass.filtEnvDec = 0.25f;
+        bass.filtEnvSus = 0.0f;
+        bass.filtEnvRel = 0.1f;
+        bass.filtEnvDpth = 1000.0f;
+        bass.filtEnvCve = -1.0f;
+        bass.filtFreq = 940.0f;
+        bass.filtRes = 2.6f;
+
+        KPSWavesParams &pluck = kps[INSTR_KPS];
+        pluck.oscMix = 0.23f;
+        pluck.noise = 0.996f;
+        pluck.ampEnvAtk = 0.315f;
+        pluck.ampEnvDec = 1.342f;
+        pluck.ampEnvSus = 0.651f;
+        pluck.ampEnvRel = 0.4f;
+        pluck.filtEnvAtk = 0.233f;
+        pluck.filtEnvDec = 0.849f;
+        pluck.filtEnvSus = 0.798f;
+        pluck.filtEnvRel = 0.261f;
+        pluck.filtEnvDpth = 1032.0f;
+        pluck.filtEnvCve = 4.0f;
+        pluck.filtFreq = 926.0f;
+        pluck.filtRes = 0.1f;
+        pluck.combDec = 0.849f;
+        pluck.combFbk = 0.314f;
+        pluck.combFfw = 0.135f;
+        pluck.pan = 0.0f;
+
+        // 5 ms of filtered noise into a damped loop; the string sets the decay
+        KPSWavesParams &string = kps[INSTR_PLUCK];
+        string.oscMix = 0.0f;
+        string.noise = 1.0f;
+        string.pluck = 0.005f;
+        string.ampEnvAtk = 0.001f;
+        string.ampEnvDec = 0.01f;
+        string.ampEnvSus = 1.0f;
+        string.ampEnvRel = 0.3f;
+        string.filtFreq = 3500.0f;
+        string.filtRes = 0.1f;
+        string.filtEnvDpth = 0.0f;
+        string.combDec = 0.6f;
+        string.combDamp = 0.35f;
+        string.combFfw = 0.0f;
+        string.pan = 0.0f;
+
+        FMParams &bell = fm[INSTR_FM];
+        bell.attackTime = 0.1f;
+        bell.releaseTime = 0.1f;
+        bell.pan = 1.0f;
     }
 };
 
+// Only the audio thread touches this once audio is running; the GUI changes
+// patches through PATCH_PARAM events
+PatchRegistry &patches()
+{
+    static PatchRegistry registry;
+    return registry;
+}
+
+// Each voice class's voices, allocated up front (see allocateVoices()) and
+// patched from patches(), so scheduling a note never constructs one
+VoicePoolBase &miniSubVoices()
+{
+    static VoicePool<MiniSubWaves, MiniSubWavesParams> pool(patches().miniSub);
+    return pool;
+}
+
+VoicePoolBase &kpsVoices()
+{
+    static VoicePool<KPSWaves, KPSWavesParams> pool(patches().kps);
+    return pool;
+}
+
+VoicePoolBase &fmVoices()
+{
+    static VoicePool<FM, FMParams> pool(patches().fm);
+    return pool;
+}
+
+static const int VOICE_POOL_SIZE = 256;
+
+// The instruments the engine plays: name in .gseq files, voices, notes
+// at once and pitch
+static const InstrumentSpec INSTRUMENTS[NUM_INSTRUMENTS] = {
+    {"MSCHORDS", miniSubVoices, 32, 1.0f},
+    {"KPS", kpsVoices, 16, 1.0f},
+    {"MSBASS", miniSubVoices, 8, 0.5f}, // an octave down
+    {"FM", fmVoices, 16, 1.0f},
+    {"PLUCK", kpsVoices, 48, 1.0f},
+};
+
 // We make an app.
 class MyApp : public App
 {
@@ -551,6 +1100,18 @@ public:
     // where the presets and sequences are stored
     SynthGUIManager<MiniSubWaves> synthManager{"MiniSubWaves"};
 
+    // notes, patch changes and songs, played on the instruments' voices
+    NoteEngine<MAX_VOICES, NUM_INSTRUMENTS> mEngine{INSTRUMENTS};
+
+    // Preallocate the voice pools and build the patches before any audio runs
+    void allocateVoices()
+    {
+        patches();
+        wavetables().build(gam::sampleRate());
+        noiseStreams().seed(NOISE_SEED);
+        mEngine.allocate(VOICE_POOL_SIZE, CPU_BUDGET, MIN_VOICES);
+    }
+
     // This function is called right after the window is created
     // It provides a grphics context to initialize ParameterGUI
     // It's also a good place to put things that should
@@ -575,12 +1136,37 @@ public:
         // Play example sequence. Comment this line to start from scratch
         // synthManager.synthSequencer().playSequence("synth1.synthSequence");
         synthManager.synthRecorder().verbose(true);
+
+        // build the voice bank now rather than on the audio thread
+        miniSubBank().ctlRate(FILTER_CTL_RATE);
+        parallelVoices().start(RENDER_THREADS, RENDER_MAX_VOICES, audioIO().framesPerBuffer());
+        allocateVoices();
+        mEngine.startFeeding();
+        if (PROFILE_AUDIO)
+            startProfiler();
+    }
+
+    void startProfiler()
+    {
+        profiler().kinds(PROFILE_KIND_NAMES, NUM_PROFILE_KINDS);
+        profiler().start();
     }
 
     // The audio callback function. Called when audio hardware requires data
     void onSound(AudioIOData &io) override
     {
-        synthManager.render(io); // Render audio
+        profiler().beginCallback();
+        mEngine.beginBlock(io);
+        mEngine.render(io); // Render audio
+        synthManager.render(io); // notes played from the synth control panel
+        parallelVoices().render(io); // voices deferred by the two above
+        if (MINISUB_USE_BANK)
+        {
+            ProfileTimer timer(profiler(), PROFILE_MINISUB);
+            miniSubBank().render(io.outBuffer(0), io.outBuffer(1), io.framesPerBuffer());
+        }
+        profiler().endCallback(io.framesPerBuffer(), io.framesPerSecond());
+        mEngine.endBlock(io);
     }
 
     void onAnimate(double dt) override
@@ -589,6 +1175,9 @@ public:
         imguiBeginFrame();
         // Draw a window that contains the synth control panel
         synthManager.drawSynthControlPanel();
+        mEngine.drawControls();
+        if (PROFILE_AUDIO)
+            drawProfiler(profiler());
         imguiEndFrame();
     }
 
@@ -598,6 +1187,7 @@ public:
         g.clear();
         // Render the synth's graphics
         synthManager.render(g);
+        mEngine.render(g);
 
         // GUI is drawn here
         imguiDraw();
@@ -692,248 +1282,342 @@ public:
         return true;
     }
 
-    void onExit() override { imguiShutdown(); }
-
-    // New code: a function to play a note A
-
-    void playNote(float freq, float time, float duration = 0.5, float amp = 0.2, float attack = 0.1, float decay = 0.1, Instrument instrument = INSTR_MSCHORDS)
+    void onExit() override
     {
-        SynthVoice *voice;
-        switch (instrument)
-        {case INSTR_MSCHORDS:
-            voice = synthManager.synth().getVoice<MiniSubWaves>();
-
-
-            voice->setInternalParameterValue("amplitude", amp);
-            voice->setInternalParameterValue("oscMix", 0.1);
-            voice->setInternalParameterValue("frequency", freq);
-
-            voice->setInternalParameterValue("ampEnvAtk", 0.1);
-            voice->setInternalParameterValue("ampEnvDec", 0.3);
-            voice->setInternalParameterValue("ampEnvSus", 0.6);
-            voice->setInternalParameterValue("ampEnvRel", 0.2);
-
-            voice->setInternalParameterValue("filtEnvAtk", 0.25);
-            voice->setInternalParameterValue("filtEnvDec", 0.2);
-            voice->setInternalParameterValue("filtEnvSus", 0.05);
-            voice->setInternalParameterValue("filtEnvRel", 0.1);
-            voice->setInternalParameterValue("filtEnvDpth", 1800);
-            voice->setInternalParameterValue("filtEnvCve", 1.0);
-            voice->setInternalParameterValue("filtFreq", 1150);
-            voice->setInternalParameterValue("filtRes", 1.0);
-
-            voice->setInternalParameterValue("pan", 0);
-            break;
-
-        case INSTR_KPS:
-            voice = synthManager.synth().getVoice<KPSWaves>();
-
-
-            voice->setInternalParameterValue("amplitude", amp);
-            voice->setInternalParameterValue("oscMix", 0.23);
-            voice->setInternalParameterValue("noise", 0.996);
-            voice->setInternalParameterValue("frequency", freq);
-            voice->setInternalParameterValue("ampEnvAtk", 0.315);
-            voice->setInternalParameterValue("ampEnvDec", 1.342);
-            voice->setInternalParameterValue("ampEnvSus", 0.651);
-            voice->setInternalParameterValue("ampEnvRel", 0.4);
-
-            voice->setInternalParameterValue("filtEnvAtk", 0.233);
-            voice->setInternalParameterValue("filtEnvDec", 0.849);
-            voice->setInternalParameterValue("filtEnvSus", 0.798);
-            voice->setInternalParameterValue("filtEnvRel", 0.261);
-            voice->setInternalParameterValue("filtEnvDpth", 1032);
-            voice->setInternalParameterValue("filtEnvCve", 4.0);
-            voice->setInternalParameterValue("filtFreq", 926);
-            voice->setInternalParameterValue("filtRes", 0.1);
-
-            voice->setInternalParameterValue("combDec", 0.849);
-            voice->setInternalParameterValue("combDel", 0.002268);
-            voice->setInternalParameterValue("combFbk", 0.314);
-            voice->setInternalParameterValue("combFfw", 0.135);
-
-            voice->setInternalParameterValue("pan", 0);
-            break;
-        
-
-        case INSTR_MSBASS:
-            voice = synthManager.synth().getVoice<MiniSubWaves>();
-
-            voice->setInternalParameterValue("amplitude", amp);
-            voice->setInternalParameterValue("oscMix", 0.7);
-            voice->setInternalParameterValue("frequency", freq / 2);
-
-            voice->setInternalParameterValue("ampEnvAtk", 0.01);
-            voice->setInternalParameterValue("ampEnvDec", 0.35);
-            voice->setInternalParameterValue("ampEnvSus", 0.6);
-            voice->setInternalParameterValue("ampEnvRel", 0.2);
-
-            voice->setInternalParameterValue("filtEnvAtk", 0.05);
-            voice->setInternalParameterValue("filtEnvDec", 0.25);
-            voice->setInternalParameterValue("filtEnvSus", 0.0);
-            voice->setInternalParameterValue("filtEnvRel", 0.1);
-            voice->setInternalParameterValue("filtEnvDpth", 1000);
-            voice->setInternalParameterValue("filtEnvCve", -1.0);
-            voice->setInternalParameterValue("filtFreq", 940);
-            voice->setInternalParameterValue("filtRes", 2.6);
-
-            break;
-
-
-        case INSTR_FM:
-            voice = synthManager.synth().getVoice<FM>();
-
-            voice->setInternalParameterValue("amplitude", amp);
-            voice->setInternalParameterValue("freq", freq);
-            voice->setInternalParameterValue("attackTime", 0.1);
-            voice->setInternalParameterValue("releaseTime", 0.1);
-            voice->setInternalParameterValue("pan", 1.0);
-
-            break;
-        default:
-            voice = nullptr;
-            break;
-        }
-        synthManager.synthSequencer().addVoiceFromNow(voice, time, duration);
+        mEngine.stopFeeding();
+        profiler().stop();
+        imguiShutdown();
     }
 
     Sequence *sequenceGH_Chords(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
+        Sequence *result = phrases().find(PHRASE_GH_CHORDS, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_CHORDS, offset);
 
-        result->addSequence(sequenceGH_ChordsPhrase1(), 0);
-        result->addSequence(sequenceGH_ChordsPhrase1(), 3.5);
+        result->addPhrase(sequenceGH_ChordsPhrase1(), 0);
+        result->addPhrase(sequenceGH_ChordsPhrase1(), 3.5);
 
         return result;
     }
 
     Sequence *sequenceGH_Bass(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
+        Sequence *result = phrases().find(PHRASE_GH_BASS, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_BASS, offset);
 
-        result->addSequence(sequenceGH_BassPhrase1(), 0);
-        result->addSequence(sequenceGH_BassPhrase1(), 3.5);
+        result->addPhrase(sequenceGH_BassPhrase1(), 0);
+        result->addPhrase(sequenceGH_BassPhrase1(), 3.5);
 
         return result;
     }
 
     Sequence *sequenceGH_ChordsPhrase1(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
-
-        std::cout << "bean" << note_freq(A4) << std::endl;
+        Sequence *result = phrases().find(PHRASE_GH_CHORDS_1, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_CHORDS_1, offset);
 
-        result->add(Note(note_freq(Fs4), 0, 0.5, 0.3));
-        result->add(Note(note_freq(B4), 0, 0.5, 0.3));
-
-        result->add(Note(note_freq(B4), 0.5, 0.5, 0.3));
-        result->add(Note(note_freq(Fs5), 0.5, 0.5, 0.3));
-
-        result->add(Note(note_freq(Fs5), 1, 0.5, 0.3));
-        result->add(Note(note_freq(Gs5), 1, 0.5, 0.3));
-
-        result->add(Note(note_freq(Gs5), 1.5, 0.5, 0.3));
-        result->add(Note(note_freq(Ds6), 1.5, 0.5, 0.3));
-
-        result->add(Note(note_freq(Gs5), 2, 0.5, 0.3));
-        result->add(Note(note_freq(Cs5), 2, 0.5, 0.3));
+        for (const Note &n : GH_CHORDS_PHRASE1)
+            result->add(n);
 
         return result;
     }
 
     Sequence *sequenceGH_BassPhrase1(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
+        Sequence *result = phrases().find(PHRASE_GH_BASS_1, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_BASS_1, offset);
 
-        result->add(Note(note_freq(E3), 0, 0.5, 0.3));
-        result->add(Note(note_freq(B3), 0.5, 0.5, 0.3));
-        result->add(Note(note_freq(Gs3), 1, 1.0, 0.3));
-
-        result->add(Note(note_freq(Ds4), 2.5, 0.5, 0.3));
-        result->add(Note(note_freq(B3), 3, 0.5, 0.3));
+        for (const Note &n : GH_BASS_PHRASE1)
+            result->add(n);
 
         return result;
     }
 
     Sequence *sequenceGHPhrase2(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
+        Sequence *result = phrases().find(PHRASE_GH_2, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_2, offset);
 
-        result->add(Note(E4 * offset, 0, 0.5, 0.1));
-        result->add(Note(F4 * offset, 1, 0.5, 0.2));
-        result->add(Note(G4 * offset, 2, 1.0, 0.3));
+        result->add(Note(note_freq(E4) * offset, 0, 0.5, 0.1));
+        result->add(Note(note_freq(F4) * offset, 1, 0.5, 0.2));
+        result->add(Note(note_freq(G4) * offset, 2, 1.0, 0.3));
 
         return result;
     }
 
     Sequence *sequenceGHPhrase3(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
-
-        result->add(Note(G4 * offset, 0, 0.25, 0.2));
-        result->add(Note(A4 * offset, 0.5, 0.25, 0.3));
-        result->add(Note(G4 * offset, 1, 0.25, 0.4));
-        result->add(Note(F4 * offset, 1.5, 0.25, 0.45));
-        result->add(Note(E4 * offset, 2, 0.5, 0.5));
-        result->add(Note(C4 * offset, 3, 0.5, 0.25));
+        Sequence *result = phrases().find(PHRASE_GH_3, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_3, offset);
+
+        result->add(Note(note_freq(G4) * offset, 0, 0.25, 0.2));
+        result->add(Note(note_freq(A4) * offset, 0.5, 0.25, 0.3));
+        result->add(Note(note_freq(G4) * offset, 1, 0.25, 0.4));
+        result->add(Note(note_freq(F4) * offset, 1.5, 0.25, 0.45));
+        result->add(Note(note_freq(E4) * offset, 2, 0.5, 0.5));
+        result->add(Note(note_freq(C4) * offset, 3, 0.5, 0.25));
 
         return result;
     }
 
     Sequence *sequenceGHPhrase4(float offset = 1.0)
     {
-        TimeSignature t;
-        Sequence *result = new Sequence(t);
+        Sequence *result = phrases().find(PHRASE_GH_4, offset);
+        if (result)
+            return result;
+        result = phrases().create(PHRASE_GH_4, offset);
 
-        result->add(Note(C4 * offset, 0, 0.5, 0.2));
-        result->add(Note(G3 * offset, 1, 0.5, 0.1));
-        result->add(Note(C4 * offset, 2, 1.0, 0.05));
+        result->add(Note(note_freq(C4) * offset, 0, 0.5, 0.2));
+        result->add(Note(note_freq(G3) * offset, 1, 0.5, 0.1));
+        result->add(Note(note_freq(C4) * offset, 2, 1.0, 0.05));
 
         return result;
     }
 
-    // bpm is beats per minute
+    void playSongGH(float offset = 1.0, float bpm = 60.0)
+    {
+        std::cout << "playSongGH: offset=" << offset << " bpm=" << bpm << std::endl;
+
+        uint64_t start = mEngine.eventClock(); // both parts start on the same frame
+        mEngine.playSequence(sequenceGH_Chords(), bpm, INSTR_KPS, start);
+
+        mEngine.playSequence(sequenceGH_Bass(), bpm, INSTR_MSBASS, start);
+    }
+
+    // Render the notes scheduled so far offline, as fast as the CPU allows,
+    // streaming them to a WAV file at path. Renders at least seconds of
+    // audio, then until every voice has finished. Needs no audio device;
+    // don't call it while the app's audio is running.
+    BounceStats bounce(const char *path, float seconds)
+    {
+        gam::sampleRate(BOUNCE_SAMPLE_RATE);
+        miniSubBank().ctlRate(FILTER_CTL_RATE);
+        parallelVoices().start(RENDER_THREADS, RENDER_MAX_VOICES, BOUNCE_BLOCK);
+        allocateVoices();
+
+        AudioIOData io;
+        io.framesPerSecond(BOUNCE_SAMPLE_RATE);
+        io.framesPerBuffer(BOUNCE_BLOCK);
+        io.channelsOut(2);
 
-    void playSequence(Sequence *s, float bpm, Instrument instrument = INSTR_MSCHORDS)
+        return mEngine.bounce(path, io, seconds, BOUNCE_MAX_TAIL, [this](AudioIOData &block) { onSound(block); });
+    }
+
+    // Bounce one sequence played on one instrument
+    BounceStats bounceSequence(Sequence *s, float bpm, Instrument instrument, const char *path)
     {
-        float secondsPerBeat = 60.0f / bpm;
+        mEngine.playSequence(s, bpm, instrument);
+        return bounce(path, s->endBeat() * 60.0f / bpm);
+    }
 
-        std::vector<Note> *notes = s->getNotes();
+    void bounceSongGH(const char *path, float offset = 1.0, float bpm = 60.0)
+    {
+        playSongGH(offset, bpm);
+        float beats = std::max(sequenceGH_Chords()->endBeat(), sequenceGH_Bass()->endBeat());
+        bounce(path, beats * 60.0f / bpm);
+    }
 
-        for (auto &note : *notes)
+    // Save the GH song as a .gseq sequence file
+    bool saveSongGH(const char *path, float bpm = 60.0)
+    {
+        std::vector<PackedNote> notes;
+        packSequence(*sequenceGH_Chords(), INSTR_KPS, notes);
+        packSequence(*sequenceGH_Bass(), INSTR_MSBASS, notes);
+        return mEngine.writeSequence(path, notes, bpm);
+    }
+
+    // Bounce a .gseq file at its own tempo; false if it can't be read
+    bool bounceSequenceFile(const char *sequencePath, const char *path)
+    {
+        MappedSequence file;
+        if (!file.open(sequencePath))
         {
-            playNote(
-                note.getFreq(),
-                note.getTime() * secondsPerBeat,
-                note.getDuration() * secondsPerBeat,
-                note.getAmp(),
-                note.getAttack(),
-                note.getDecay(),
-                instrument);
+            std::cerr << sequencePath << " is not a sequence file" << std::endl;
+            return false;
         }
+        mEngine.playSequenceFile(file, file.bpm());
+        bounce(path, file.endBeat() * 60.0f / file.bpm());
+        mEngine.clearSongs(); // file is closed on return
+        return true;
     }
 
-    void playSongGH(float offset = 1.0, float bpm = 60.0)
+    // --- voice benchmarks (--bench) ---
+
+    // heap allocations the benchmarked voices made, counted in a build with
+    // -DCOUNT_ALLOCS (see alloc_counter.h)
+    long mBenchAllocs = 0;
+
+    // Render one voice alone for seconds, with no audio device: a note every
+    // second or so, released 3/4 of the way through, in BOUNCE_BLOCK blocks.
+    // Everything the voice does counts towards mBenchAllocs.
+    template <class Voice, class Params>
+    BenchResult benchVoiceRender(Voice &voice, const Params &patch, float seconds)
     {
-        std::cout << "playSongGH: offset=" << offset << " bpm=" << bpm << std::endl;
+        AudioIOData io;
+        io.framesPerSecond(BOUNCE_SAMPLE_RATE);
+        io.framesPerBuffer(BOUNCE_BLOCK);
+        io.channelsOut(2);
+
+        const int noteBlocks = (int)(BOUNCE_SAMPLE_RATE / BOUNCE_BLOCK);
+        int block = 0;
+        auto render = [&](long numSamples) {
+            for (long done = 0; done < numSamples; done += BOUNCE_BLOCK)
+            {
+                long allocs = threadAllocCount();
+                if (block % noteBlocks == 0)
+                {
+                    voice.applyPatch(patch, 0.2f, 220.0f);
+                    voice.triggerOn(0);
+                    renderHere(voice);
+                }
+                if (block % noteBlocks == noteBlocks * 3 / 4)
+                    voice.releaseAt(BOUNCE_BLOCK / 2);
+                io.zeroOut();
+                io.frame(0);
+                voice.renderAudio(io);
+                mBenchAllocs += threadAllocCount() - allocs;
+                doNotOptimize(io.outBuffer(0)[BOUNCE_BLOCK - 1]);
+                block++;
+            }
+        };
+        return benchVoice(render, (long)(seconds * BOUNCE_SAMPLE_RATE), BOUNCE_SAMPLE_RATE);
+    }
 
-        playSequence(sequenceGH_Chords(), bpm, INSTR_KPS);
+    // Keep a benchmarked note out of miniSubBank() so the voice's own
+    // render loop is what gets timed
+    static void renderHere(SynthVoice &) {}
+    static void renderHere(MiniSubWaves &voice)
+    {
+        int lane = voice.mLane.exchange(-1, std::memory_order_relaxed);
+        if (lane >= 0)
+            miniSubBank().release(lane);
+    }
 
-        playSequence(sequenceGH_Bass(), bpm, INSTR_MSBASS);
+    // Benchmark voice on patch with field set to each of values in turn
+    template <class Voice, class Params, int N>
+    void benchSweep(const char *voiceName, Voice &voice, Params patch, const char *fieldName, float Params::*field,
+                    const float (&values)[N], float seconds)
+    {
+        for (float value : values)
+        {
+            patch.*field = value;
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s/%s:%g", voiceName, fieldName, value);
+            printBench(name, benchVoiceRender(voice, patch, seconds));
+        }
+    }
+
+    // Time each voice kind across sweeps of the parameters that change its
+    // cost, starting from the demo's patches. Returns the heap allocations
+    // the voices made (always 0 unless built with -DCOUNT_ALLOCS).
+    long benchVoices(float seconds)
+    {
+        mBenchAllocs = 0;
+        gam::sampleRate(BOUNCE_SAMPLE_RATE);
+        wavetables().build(BOUNCE_SAMPLE_RATE);
+        std::printf("%.0f Hz, %d-frame blocks, %g s per run\n", BOUNCE_SAMPLE_RATE, BOUNCE_BLOCK, seconds);
+
+        const float depths[] = {0.0f, 600.0f, 1800.0f, 4800.0f};
+        const float resonances[] = {0.1f, 1.0f, 4.0f, 10.0f};
+        MiniSubWaves miniSub;
+        miniSub.init();
+        benchSweep("MiniSubWaves", miniSub, patches().miniSub[INSTR_MSCHORDS], "filtEnvDpth",
+                   &MiniSubWavesParams::filtEnvDpth, depths, seconds);
+        benchSweep("MiniSubWaves", miniSub, patches().miniSub[INSTR_MSCHORDS], "filtRes", &MiniSubWavesParams::filtRes,
+                   resonances, seconds);
+
+        // combDec sets the loop feedback: decay() overrides combFbk, so the
+        // ring time is what to sweep (0 is no feedback)
+        const float decays[] = {0.0f, 0.1f, 0.5f, 1.0f};
+        KPSWaves kps;
+        kps.init();
+        benchSweep("KPSWaves", kps, patches().kps[INSTR_KPS], "filtEnvDpth", &KPSWavesParams::filtEnvDpth, depths, seconds);
+        benchSweep("KPSWaves", kps, patches().kps[INSTR_KPS], "filtRes", &KPSWavesParams::filtRes, resonances, seconds);
+        benchSweep("KPSWaves", kps, patches().kps[INSTR_KPS], "combDec", &KPSWavesParams::combDec, decays, seconds);
+        // pluck 0 keeps exciting the string for the whole note, as INSTR_KPS does
+        const float plucks[] = {0.0f, 0.02f, 0.005f, 0.001f};
+        benchSweep("KPSWaves", kps, patches().kps[INSTR_PLUCK], "pluck", &KPSWavesParams::pluck, plucks, seconds);
+
+        // idx2 is the modulation index the note sustains at
+        const float indices[] = {0.0f, 2.0f, 7.0f, 10.0f};
+        FM fm;
+        fm.init();
+        benchSweep("FM", fm, patches().fm[INSTR_FM], "idx2", &FMParams::idx2, indices, seconds);
+
+        if (ALLOCS_COUNTED)
+            std::printf("\n%ld heap allocations while rendering\n", mBenchAllocs);
+        else
+            std::printf("\nheap allocations not counted (build with -DCOUNT_ALLOCS)\n");
+        return mBenchAllocs;
     }
 };
 
-int main()
+int main(int argc, char *argv[])
 {
     // Create app instance
     MyApp app;
 
+    // --bounce [file.wav [song.gseq]]: render the song (or a sequence file)
+    // to a WAV file instead of playing it
+    if (argc > 1 && std::string(argv[1]) == "--bounce")
+    {
+        const char *path = argc > 2 ? argv[2] : "GrumpyKP.wav";
+        if (argc > 3)
+            return app.bounceSequenceFile(argv[3], path) ? 0 : 1;
+        app.bounceSongGH(path);
+        return 0;
+    }
+
+    // --profile [report.txt]: bounce the song as --bounce does, timing every
+    // callback, and write the profiler's percentiles (to stdout by default)
+    if (argc > 1 && std::string(argv[1]) == "--profile")
+    {
+        app.startProfiler();
+        app.bounceSongGH("GrumpyKP.wav");
+        profiler().stop();
+        std::FILE *out = argc > 2 ? std::fopen(argv[2], "w") : stdout;
+        if (!out)
+            return 1;
+        profiler().report(out);
+        if (out != stdout)
+            std::fclose(out);
+        return 0;
+    }
+
+    // --bench [seconds]: time each voice kind on its own, no audio device;
+    // fails if a voice allocated (built with -DCOUNT_ALLOCS)
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+    {
+        float seconds = BENCH_SECONDS;
+        if (argc > 2)
+        {
+            char *end;
+            seconds = std::strtof(argv[2], &end);
+            if (end == argv[2] || *end != '\0' || !std::isfinite(seconds) || seconds <= 0.0f)
+            {
+                std::fprintf(stderr, "usage: %s --bench [seconds > 0]\n", argv[0]);
+                return 2;
+            }
+        }
+        return app.benchVoices(seconds) == 0 ? 0 : 1;
+    }
+
+    // --save [file.gseq]: write the song as a sequence file
+    if (argc > 1 && std::string(argv[1]) == "--save")
+        return app.saveSongGH(argc > 2 ? argv[2] : "GrumpyKP.gseq") ? 0 : 1;
+
     // Set up audio
     app.configureAudio(48000., 512, 2, 0);
 
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counter for checking that real-time code never allocates.
+//
+// Define COUNT_ALLOCS before including this header (in one source file only)
+// to replace the global operator new/delete with versions that count
+// allocations per thread. Without COUNT_ALLOCS the counter stays at zero and
+// NoAllocScope does nothing useful, so it can be left in release code.
+// 19_GrumpyHatBase and 25_GrumpyKP built with -DCOUNT_ALLOCS count what
+// their real voices allocate under --bench, and fail if it isn't zero.
+// bench/comb_alloc_test.cpp defines it to check the Karplus-Strong comb,
+// bench/replay_alloc_test.cpp to check that replaying a song doesn't allocate.
+
+// Number of allocations made so far by the calling thread
+inline long &threadAllocCount()
+{
+    thread_local long count = 0;
+    return count;
+}
+
+#ifdef COUNT_ALLOCS
+static const bool ALLOCS_COUNTED = true;
+
+void *operator new(std::size_t size)
+{
+    threadAllocCount()++;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#else
+static const bool ALLOCS_COUNTED = false;
+#endif
+
+// Asserts (in debug builds) that the enclosing scope made no allocations,
+// e.g. at the top of a voice's onProcess(AudioIOData &)
+class NoAllocScope
+{
+private:
+    long mStart;
+
+public:
+    NoAllocScope() : mStart(threadAllocCount()) {}
+    ~NoAllocScope()
+    {
+        assert(threadAllocCount() == mStart && "heap allocation on the audio thread");
+    }
+    long allocations() const { return threadAllocCount() - mStart; }
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.h"
+
+// Audio callback profiler.
+//
+// The audio thread times each callback and the voices rendered in it, and
+// pushes one small record per callback into a wait-free SpscQueue. A
+// background thread drains the queue into a window of the last
+// PROFILE_WINDOW callbacks plus running totals. Nothing on the audio side
+// locks, allocates or prints; the GUI (or a report at exit) asks the
+// background side for percentiles with stats().
+//
+// Voices are timed per kind (e.g. one kind per voice class), so the cost of
+// each synth shows separately. Voice times may be added from render pool
+// threads; everything else on the audio side is audio thread only.
+
+static const int PROFILE_MAX_KINDS = 4;
+static const int PROFILE_QUEUE_SIZE = 1024;
+static const int PROFILE_WINDOW = 4096;
+
+struct ProfileRecord
+{
+    float callbackUs;
+    float budgetUs; // how long the block lasts
+    float voiceUs[PROFILE_MAX_KINDS]; // all voices of each kind together
+    uint16_t voices[PROFILE_MAX_KINDS];
+};
+
+struct Percentiles
+{
+    float p50, p99, max;
+};
+
+struct ProfileStats
+{
+    uint64_t callbacks;
+    uint64_t deadlineMisses; // callbacks that took longer than their block lasts
+    uint64_t dropped;        // records lost because the drain thread fell behind
+    float budgetUs;
+    float worstUs; // slowest callback since start()
+    int window;    // callbacks the percentiles cover
+    Percentiles callbackUs;
+    Percentiles load; // callback time / budget
+    Percentiles voiceUs[PROFILE_MAX_KINDS]; // per voice, in callbacks that had one
+    Percentiles voices[PROFILE_MAX_KINDS];
+};
+
+class AudioProfiler
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int mNumKinds = 0;
+    const char *const *mKindNames = nullptr;
+    std::atomic<bool> mEnabled{false};
+
+    // audio side
+    SpscQueue<ProfileRecord, PROFILE_QUEUE_SIZE> mQueue;
+    Clock::time_point mStart;
+    std::atomic<uint64_t> mVoiceNs[PROFILE_MAX_KINDS];
+    int mVoices[PROFILE_MAX_KINDS];
+    std::atomic<uint64_t> mDropped{0};
+
+    // drain side, guarded by mLock
+    std::mutex mLock;
+    ProfileRecord mWindow[PROFILE_WINDOW];
+    int mWindowSize = 0;
+    int mWindowNext = 0;
+    uint64_t mCallbacks = 0;
+    uint64_t mMisses = 0;
+    float mWorstUs = 0.0f;
+    std::vector<float> mScratch;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+
+    void drain()
+    {
+        ProfileRecord r;
+        std::lock_guard<std::mutex> lock(mLock);
+        while (mQueue.pop(r))
+        {
+            mWindow[mWindowNext] = r;
+            mWindowNext = (mWindowNext + 1) % PROFILE_WINDOW;
+            mWindowSize = std::min(mWindowSize + 1, PROFILE_WINDOW);
+            mCallbacks++;
+            mMisses += r.callbackUs > r.budgetUs;
+            mWorstUs = std::max(mWorstUs, r.callbackUs);
+        }
+    }
+
+    // Percentiles of mScratch (which gets reordered)
+    Percentiles percentiles()
+    {
+        Percentiles p = {0.0f, 0.0f, 0.0f};
+        size_t n = mScratch.size();
+        if (n == 0)
+            return p;
+        auto at = [&](size_t i) {
+            std::nth_element(mScratch.begin(), mScratch.begin() + i, mScratch.end());
+            return mScratch[i];
+        };
+        p.p50 = at(n / 2);
+        p.p99 = at(std::min(n - 1, n * 99 / 100));
+        p.max = *std::max_element(mScratch.begin(), mScratch.end());
+        return p;
+    }
+
+public:
+    AudioProfiler()
+    {
+        for (int k = 0; k < PROFILE_MAX_KINDS; k++)
+        {
+            mVoiceNs[k] = 0;
+            mVoices[k] = 0;
+        }
+        mScratch.reserve(PROFILE_WINDOW);
+    }
+
+    ~AudioProfiler() { stop(); }
+
+    // Name the voice kinds (up to PROFILE_MAX_KINDS); call before start()
+    void kinds(const char *const *names, int numKinds)
+    {
+        mKindNames = names;
+        mNumKinds = std::min(numKinds, PROFILE_MAX_KINDS);
+    }
+
+    int numKinds() const { return mNumKinds; }
+    const char *kindName(int kind) const { return mKindNames[kind]; }
+
+    // Start timing, and the thread that collects the records
+    void start()
+    {
+        if (mRunning)
+            return;
+        mRunning = true;
+        mEnabled = true;
+        mThread = std::thread([this] {
+            while (mRunning.load(std::memory_order_acquire))
+            {
+                drain();
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        });
+    }
+
+    // Stop the collecting thread once it has taken every record
+    void stop()
+    {
+        if (!mRunning)
+            return;
+        mRunning = false;
+        mThread.join();
+        drain();
+        mEnabled = false;
+    }
+
+    bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    // --- audio thread ---
+
+    void beginCallback()
+    {
+        if (enabled())
+            mStart = Clock::now();
+    }
+
+    void countVoice(int kind) { mVoices[kind]++; }
+
+    // Any thread: add ns of rendering to a voice kind (see ProfileTimer)
+    void addVoiceTime(int kind, uint64_t ns)
+    {
+        mVoiceNs[kind].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void endCallback(int frames, double sampleRate)
+    {
+        if (!enabled())
+            return;
+        ProfileRecord r;
+        r.callbackUs = std::chrono::duration<float, std::micro>(Clock::now() - mStart).count();
+        r.budgetUs = (float)(frames / sampleRate * 1e6);
+        for (int k = 0; k < PROFILE_MAX_KINDS; k++)
+        {
+            r.voiceUs[k] = mVoiceNs[k].exchange(0, std::memory_order_relaxed) * 1e-3f;
+            r.voices[k] = (uint16_t)std::min(mVoices[k], 65535);
+            mVoices[k] = 0;
+        }
+        if (!mQueue.push(r))
+            mDropped.store(mDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // --- any other thread ---
+
+    ProfileStats stats()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        ProfileStats s;
+        s.callbacks = mCallbacks;
+        s.deadlineMisses = mMisses;
+        s.dropped = mDropped.load(std::memory_order_relaxed);
+        s.budgetUs = mWindowSize ? mWindow[(mWindowNext + PROFILE_WINDOW - 1) % PROFILE_WINDOW].budgetUs : 0.0f;
+        s.worstUs = mWorstUs;
+        s.window = mWindowSize;
+
+        mScratch.clear();
+        for (int i = 0; i < mWindowSize; i++)
+            mScratch.push_back(mWindow[i].callbackUs);
+        s.callbackUs = percentiles();
+
+        mScratch.clear();
+        for (int i = 0; i < mWindowSize; i++)
+            mScratch.push_back(mWindow[i].callbackUs / mWindow[i].budgetUs);
+        s.load = percentiles();
+
+        for (int k = 0; k < PROFILE_MAX_KINDS; k++)
+        {
+            mScratch.clear();
+            for (int i = 0; i < mWindowSize; i++)
+                if (mWindow[i].voices[k])
+                    mScratch.push_back(mWindow[i].voiceUs[k] / mWindow[i].voices[k]);
+            s.voiceUs[k] = percentiles();
+
+            mScratch.clear();
+            for (int i = 0; i < mWindowSize; i++)
+                mScratch.push_back(mWindow[i].voices[k]);
+            s.voices[k] = percentiles();
+        }
+        return s;
+    }
+
+    // Write stats() as a plain text table, e.g. for a CI log
+    void report(std::FILE *out)
+    {
+        ProfileStats s = stats();
+        std::fprintf(out, "callbacks %llu  deadline misses %llu  dropped records %llu  budget %.0f us\n",
+                     (unsigned long long)s.callbacks, (unsigned long long)s.deadlineMisses,
+                     (unsigned long long)s.dropped, s.budgetUs);
+        std::fprintf(out, "last %d callbacks:       p50       p99       max\n", s.window);
+        std::fprintf(out, "  callback us     %9.1f %9.1f %9.1f  (worst ever %.1f)\n", s.callbackUs.p50,
+                     s.callbackUs.p99, s.callbackUs.max, s.worstUs);
+        std::fprintf(out, "  load %%          %9.1f %9.1f %9.1f\n", 100.0f * s.load.p50, 100.0f * s.load.p99,
+                     100.0f * s.load.max);
+        for (int k = 0; k < mNumKinds; k++)
+        {
+            std::fprintf(out, "  %-12s us %9.2f %9.2f %9.2f  per voice\n", mKindNames[k], s.voiceUs[k].p50,
+                         s.voiceUs[k].p99, s.voiceUs[k].max);
+            std::fprintf(out, "  %-12s    %9.0f %9.0f %9.0f  voices\n", "", s.voices[k].p50, s.voices[k].p99,
+                         s.voices[k].max);
+        }
+    }
+};
+
+// Times a scope and adds it to a voice kind, e.g. at the top of a voice's
+// render function
+class ProfileTimer
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    AudioProfiler &mProfiler;
+    int mKind;
+    bool mOn;
+    Clock::time_point mStart;
+
+public:
+    ProfileTimer(AudioProfiler &profiler, int kind) : mProfiler(profiler), mKind(kind)
+    {
+        mOn = profiler.enabled();
+        if (mOn)
+            mStart = Clock::now();
+    }
+
+    ~ProfileTimer()
+    {
+        if (!mOn)
+            return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mStart).count();
+        mProfiler.addVoiceTime(mKind, (uint64_t)ns);
+    }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// Tiny timing helpers shared by the benchmark programs in this folder.
+// Nothing here needs an audio device or a window.
+
+// Prevent the optimizer from throwing away a rendered result
+template <class T>
+inline void doNotOptimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult
+{
+    double nsPerSample;
+    double voicesPerCore; // voices that fit in one core in real time
+};
+
+// Time render(numSamples) and return ns per sample, taking the best of
+// several runs to reduce scheduler noise. render is expected to produce
+// numSamples samples of one voice.
+template <class RenderFunc>
+BenchResult benchVoice(RenderFunc render, long numSamples, double sampleRate = 48000.0, int runs = 5)
+{
+    render(numSamples / 10); // warm up caches
+
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        render(numSamples);
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        if (ns < best)
+            best = ns;
+    }
+
+    BenchResult result;
+    result.nsPerSample = best / numSamples;
+    result.voicesPerCore = 1e9 / (sampleRate * result.nsPerSample);
+    return result;
+}
+
+inline void printBench(const char *name, BenchResult r)
+{
+    std::printf("%-40s %9.2f ns/sample %9.0f voices/core\n", name, r.nsPerSample, r.voicesPerCore);
+}
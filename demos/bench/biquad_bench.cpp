@@ -0,0 +1,87 @@
+// Compares the per-sample filter sweep used by MiniSubWaves with the
+// block-rate BlockBiquad engine.
+//
+// build: g++ -O2 -std=c++17 biquad_bench.cpp -o biquad_bench
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../block_biquad.h"
+#include "bench.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+
+// Render one voice's worth of filter sweep: a naive saw through the low pass,
+// with the cutoff driven by a repeating attack/decay envelope like the
+// INSTR_MSCHORDS patch (filtEnvAtk 0.25, filtEnvDec 0.2, filtEnvSus 0.05,
+// filtFreq 1150, filtEnvDpth 1800, filtRes 1.0)
+static float renderSweep(BlockBiquad &filter, float *out, long numSamples)
+{
+    const long attackLen = (long)(0.25f * SAMPLE_RATE);
+    const long noteLen = (long)(1.0f * SAMPLE_RATE);
+    const float sustain = 0.05f;
+    const float decayMul = std::exp(-1.0f / (0.2f * SAMPLE_RATE));
+
+    float phase = 0.0f;
+    float inc = 220.0f / SAMPLE_RATE;
+    float env = sustain;
+    float sum = 0.0f;
+    for (long i = 0; i < numSamples; i++)
+    {
+        phase += inc;
+        if (phase >= 1.0f)
+            phase -= 1.0f;
+
+        long t = i % noteLen;
+        if (t < attackLen)
+            env += (1.0f - sustain) / attackLen;
+        else
+            env = sustain + (env - sustain) * decayMul;
+
+        filter.freq(1150.0f + env * 1800.0f);
+        float s = filter(phase * 2.0f - 1.0f);
+        if (out)
+            out[i] = s;
+        sum += s;
+    }
+    return sum;
+}
+
+int main()
+{
+    const long numSamples = (long)SAMPLE_RATE * 10;
+    const int rates[] = {1, 8, 16, 32, 64};
+
+    std::vector<float> reference(numSamples), test(numSamples);
+    {
+        BlockBiquad filter(1);
+        filter.sampleRate(SAMPLE_RATE);
+        filter.res(1.0f);
+        renderSweep(filter, reference.data(), numSamples);
+    }
+
+    std::printf("10 s filter sweep at %.0f Hz\n", SAMPLE_RATE);
+    for (int rate : rates)
+    {
+        BlockBiquad filter(rate);
+        filter.sampleRate(SAMPLE_RATE);
+        filter.res(1.0f);
+
+        // deviation from the per-sample path
+        renderSweep(filter, test.data(), numSamples);
+        float maxErr = 0.0f;
+        for (long i = 0; i < numSamples; i++)
+            maxErr = std::fmax(maxErr, std::fabs(test[i] - reference[i]));
+
+        BenchResult r = benchVoice(
+            [&](long n) { doNotOptimize(renderSweep(filter, nullptr, n)); },
+            numSamples, SAMPLE_RATE);
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "ctlRate %2d%s", rate, rate == 1 ? " (per-sample)" : "");
+        printBench(name, r);
+        std::printf("%-40s max deviation %.5f\n", "", maxErr);
+    }
+    return 0;
+}
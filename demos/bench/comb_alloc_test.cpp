@@ -0,0 +1,136 @@
+// Checks that a Karplus-Strong voice never touches the heap once its comb
+// is set up: renders blocks while sweeping the note frequency, the comb
+// delay, damping and sample rate the way KPSWaves::updateFromParameters()
+// and renderAudio() change them, for each interpolation mode, and counts
+// heap allocations with alloc_counter.h.
+//
+// The voice loop is rebuilt from the same parts the demo uses (WavetableOsc,
+// BlockNoise, BlockBiquad, FixedComb), so it runs without allolib. Exits
+// non-zero if any block allocated, or if the counter isn't counting. The
+// real voices are checked by building 25_GrumpyKP with -DCOUNT_ALLOCS and
+// running it with --bench, which fails if any of them allocated.
+//
+// build: g++ -O2 -std=c++17 comb_alloc_test.cpp -o comb_alloc_test
+
+#define COUNT_ALLOCS
+#include "../alloc_counter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../block_biquad.h"
+#include "../block_noise.h"
+#include "../fixed_comb.h"
+#include "../wavetable.h"
+#include "bench.h"
+
+static const float MAX_SAMPLE_RATE = 96000.0f;
+static const float LOWEST_FREQ = 20.0f;
+static const int BLOCK = 512;
+static const int CTL_RATE = 32;
+
+struct String
+{
+    WavetableOsc osc;
+    BlockNoise noise;
+    BlockBiquad filter{CTL_RATE};
+    FixedComb comb;
+
+    // once per note, as onTriggerOn()
+    void start(float sampleRate, CombInterp interp, uint32_t stream)
+    {
+        noise.seed(1, stream);
+        filter.sampleRate(sampleRate);
+        filter.res(0.1f);
+        filter.reset();
+        comb.ipolType(interp);
+        comb.sampleRate(sampleRate);
+        comb.reset();
+    }
+
+    // once per block, as updateFromParameters() and renderAudio()
+    void update(const WavetableBank &tables, float sampleRate, float freq, float delay, float damp)
+    {
+        osc.freq(tables, freq);
+        filter.freq(926.0f + freq);
+        comb.damping(damp);
+        comb.delay(delay);
+        comb.delaySamples(sampleRate / freq);
+        comb.ffd(0.0f);
+        comb.fbk(0.5f);
+        comb.decay(0.6f);
+    }
+
+    void render(float *out, int frames)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            float s = osc.mix(0.23f) * 0.004f + noise() * 0.996f;
+            out[i] = comb(filter(s));
+        }
+    }
+};
+
+int main()
+{
+    // the counter has to see this one, or nothing below proves anything
+    long before = threadAllocCount();
+    {
+        std::vector<float> probe(16);
+        doNotOptimize(probe.data());
+    }
+    if (threadAllocCount() == before)
+    {
+        std::printf("allocation counter is not counting\n");
+        return 1;
+    }
+
+    // everything that allocates, done up front as the demo's init() does
+    WavetableBank tables;
+    String string;
+    string.comb.capacity(1.0f / LOWEST_FREQ, MAX_SAMPLE_RATE);
+    std::vector<float> out(BLOCK);
+
+    const float sampleRates[] = {44100.0f, 48000.0f, 96000.0f};
+    const CombInterp interps[] = {COMB_LINEAR, COMB_ALLPASS, COMB_LAGRANGE};
+    const char *interpNames[] = {"linear", "allpass", "lagrange"};
+
+    long blocks = 0;
+    long allocations = 0;
+    uint32_t stream = 0;
+    for (float sampleRate : sampleRates)
+    {
+        tables.build(sampleRate);
+        for (int m = 0; m < 3; m++)
+        {
+            long start = threadAllocCount();
+            // every MIDI note from 20 Hz up, then a glide back down across
+            // the whole range, with the comb delay parameter swept too (past
+            // the capacity, which has to clamp rather than grow)
+            for (int note = 16; note <= 127; note++)
+            {
+                float freq = 440.0f * std::pow(2.0f, (note - 69) / 12.0f);
+                string.start(sampleRate, interps[m], stream++);
+                for (int b = 0; b < 4; b++)
+                {
+                    string.update(tables, sampleRate, freq, 0.001f + 0.5f * b, (note % 10) * 0.099f);
+                    string.render(out.data(), BLOCK);
+                    blocks++;
+                }
+            }
+            for (float freq = 12000.0f; freq > LOWEST_FREQ; freq *= 0.97f)
+            {
+                string.update(tables, sampleRate, freq, 2.0f / freq, 0.35f);
+                string.render(out.data(), BLOCK);
+                blocks++;
+            }
+            long n = threadAllocCount() - start;
+            std::printf("%6.0f Hz %-9s %ld allocations\n", sampleRate, interpNames[m], n);
+            allocations += n;
+        }
+    }
+
+    std::printf("\n%ld blocks, %s\n", blocks, allocations ? "HEAP ALLOCATIONS WHILE RENDERING" : "no heap allocations");
+    return allocations ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+// The fastmath.h kernels against the libm calls they replace: worst error
+// over a sweep of each kernel's documented range, measured against double
+// precision, and the cost per call.
+//
+// Whole MIDI notes are timed from notes.h's compile-time table too.
+//
+// Also times BlockBiquad's coefficient design, which runs once per control
+// block per voice, with std::sin/std::cos and with the table (the numbers
+// are the same design() arithmetic, rebuilt here around both).
+//
+// build: g++ -O2 -std=c++17 fastmath_bench.cpp -o fastmath_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../fastmath.h"
+#include "../notes.h"
+#include "bench.h"
+
+static const int NUM_INPUTS = 4096;
+static const long CALLS = 20000000;
+
+// ns per call of f over inputs, best of five runs
+template <class Func>
+static double timeCalls(const std::vector<float> &inputs, Func f)
+{
+    double best = 1e30;
+    for (int run = 0; run < 5; run++)
+    {
+        float sum = 0.0f;
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < CALLS; i += NUM_INPUTS)
+            for (int k = 0; k < NUM_INPUTS; k++)
+                sum += f(inputs[k]);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        doNotOptimize(sum);
+        best = ns < best ? ns : best;
+    }
+    return best / CALLS;
+}
+
+static std::vector<float> sweep(float lo, float hi)
+{
+    std::vector<float> v(NUM_INPUTS);
+    for (int k = 0; k < NUM_INPUTS; k++)
+        v[k] = lo + (hi - lo) * ((k * 2654435761u) % NUM_INPUTS) / (float)NUM_INPUTS; // scrambled order
+    return v;
+}
+
+// Worst error of fast against exact over n points from lo to hi; relative
+// to exact if relative
+template <class Fast, class Exact>
+static double worstError(float lo, float hi, Fast fast, Exact exact, bool relative, int n = 2000000)
+{
+    double worst = 0.0;
+    for (int k = 0; k <= n; k++)
+    {
+        float x = (float)(lo + ((double)hi - lo) * k / n);
+        double e = exact((double)x);
+        double err = std::fabs((double)fast(x) - e);
+        if (relative)
+            err /= std::fabs(e);
+        worst = err > worst ? err : worst;
+    }
+    return worst;
+}
+
+template <class Fast, class Slow, class Exact>
+static void report(const char *name, float lo, float hi, Fast fast, Slow slow, Exact exact, bool relative,
+                   const char *unit = "")
+{
+    std::vector<float> inputs = sweep(lo, hi);
+    double fastNs = timeCalls(inputs, fast);
+    double slowNs = timeCalls(inputs, slow);
+    double fastErr = worstError(lo, hi, fast, exact, relative);
+    double slowErr = worstError(lo, hi, slow, exact, relative);
+    std::printf("%-14s %6.2f ns (libm %6.2f)   worst %s error %.2e%s (libm float %.2e)\n", name, fastNs, slowNs,
+                relative ? "rel" : "abs", fastErr, unit, slowErr);
+}
+
+struct Coefs
+{
+    float c0, c1, e1, e2;
+};
+
+// BlockBiquad::design() as it was
+static Coefs designLibm(float w, float res)
+{
+    float real = std::cos(w);
+    float alpha = std::sin(w) * 0.5f / res;
+    float norm = 1.0f / (1.0f + alpha);
+    return {(1.0f - real) * norm * 0.5f, (1.0f - real) * norm, -2.0f * real * norm, (1.0f - alpha) * norm};
+}
+
+// and as it is now: from the table, with 1 - cos w taken as 2 sin^2(w / 2)
+static Coefs designTable(float w, float res)
+{
+    const SineTable &sine = sineTable();
+    uint32_t phase = (uint32_t)(int32_t)(w * (0.15915494f * 2147483648.0f));
+    float half = sine(phase);
+    float halfCos = sine(phase + (1u << 30));
+    float oneMinusCos = 2.0f * half * half;
+    float alpha = half * halfCos / res;
+    float norm = 1.0f / (1.0f + alpha);
+    return {oneMinusCos * norm * 0.5f, oneMinusCos * norm, -2.0f * (1.0f - oneMinusCos) * norm, (1.0f - alpha) * norm};
+}
+
+int main()
+{
+    report("fastSin", -3.1416f, 3.1416f, [](float x) { return fastSin(x); }, [](float x) { return std::sin(x); },
+           [](double x) { return std::sin(x); }, false);
+    report("fastSin", -1000.0f, 1000.0f, [](float x) { return fastSin(x); }, [](float x) { return std::sin(x); },
+           [](double x) { return std::sin(x); }, false);
+    report("fastCos", -1000.0f, 1000.0f, [](float x) { return fastCos(x); }, [](float x) { return std::cos(x); },
+           [](double x) { return std::cos(x); }, false);
+    report("fastExp2", -126.0f, 127.9f, [](float x) { return fastExp2(x); }, [](float x) { return std::exp2(x); },
+           [](double x) { return std::exp2(x); }, true);
+    report("fastLog2", 1.2e-38f, 1e38f, [](float x) { return fastLog2(x); }, [](float x) { return std::log2(x); },
+           [](double x) { return std::log2(x); }, false);
+    report("fastLog2 (0-1)", 1e-7f, 1.0f, [](float x) { return fastLog2(x); }, [](float x) { return std::log2(x); },
+           [](double x) { return std::log2(x); }, false);
+
+    // pitch errors in cents
+    auto cents = [](double ratio) { return 1200.0 * std::log2(ratio); };
+    std::printf("%-14s worst error %.2e cents (std::pow %.2e)\n", "pitchToFreq",
+                worstError(-128.0f, 128.0f, [&](float s) { return cents(pitchToFreq(s) / (440.0 * std::exp2(s / 12.0))); },
+                           [](double) { return 0.0; }, false),
+                worstError(-128.0f, 128.0f,
+                           [&](float s) { return cents(440.0f * std::pow(1.0594630943592952646f, s) / (440.0 * std::exp2(s / 12.0))); },
+                           [](double) { return 0.0; }, false));
+    std::printf("%-14s worst error %.2e cents\n", "centsToRatio",
+                worstError(-4800.0f, 4800.0f, [&](float c) { return cents(centsToRatio(c)) - c; }, [](double) { return 0.0; },
+                           false));
+    {
+        std::vector<float> inputs = sweep(-60.0f, 60.0f);
+        std::printf("%-14s %6.2f ns (std::pow %6.2f)\n", "pitchToFreq", timeCalls(inputs, [](float s) { return pitchToFreq(s); }),
+                    timeCalls(inputs, [](float s) { return 440.0f * std::pow(1.0594630943592952646f, s); }));
+        // whole MIDI notes, as note_freq() takes them, from the notes.h table
+        std::vector<float> notes = sweep(0.0f, 127.0f);
+        std::printf("%-14s %6.2f ns\n", "MIDI_440[note]", timeCalls(notes, [](float n) { return MIDI_440[(int)n]; }));
+    }
+
+    report("dbToAmp", -700.0f, 700.0f, [](float x) { return dbToAmp(x); },
+           [](float x) { return std::pow(10.0f, x / 20.0f); }, [](double x) { return std::pow(10.0, x / 20.0); }, true);
+    report("ampToDb", 1e-7f, 1e4f, [](float x) { return ampToDb(x); }, [](float x) { return 20.0f * std::log10(x); },
+           [](double x) { return 20.0 * std::log10(x); }, false, " dB");
+
+    // biquad design
+    {
+        std::vector<float> inputs = sweep(20.0f / 48000.0f * 6.2831853f, 0.499f * 6.2831853f);
+        std::printf("%-14s %6.2f ns (libm %6.2f)\n", "biquad design",
+                    timeCalls(inputs, [](float w) { return designTable(w, 1.0f).c1; }),
+                    timeCalls(inputs, [](float w) { return designLibm(w, 1.0f).c1; }));
+        double worst = 0.0;
+        for (float hz = 20.0f; hz < 23900.0f; hz *= 1.001f)
+        {
+            float w = hz / 48000.0f * 6.2831853f;
+            double exact = (1.0 - std::cos((double)w)) / (1.0 + std::sin((double)w) * 0.5);
+            double err = std::fabs(designTable(w, 1.0f).c1 - exact) / exact;
+            worst = err > worst ? err : worst;
+        }
+        std::printf("%-14s worst rel error of b1 from 20 Hz up %.2e (libm float %.2e)\n", "", worst,
+                    [] {
+                        double w0 = 0.0;
+                        for (float hz = 20.0f; hz < 23900.0f; hz *= 1.001f)
+                        {
+                            float w = hz / 48000.0f * 6.2831853f;
+                            double exact = (1.0 - std::cos((double)w)) / (1.0 + std::sin((double)w) * 0.5);
+                            double err = std::fabs(designLibm(w, 1.0f).c1 - exact) / exact;
+                            w0 = err > w0 ? err : w0;
+                        }
+                        return w0;
+                    }());
+    }
+    return 0;
+}
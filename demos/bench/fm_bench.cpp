@@ -0,0 +1,133 @@
+// The FM voice's oscillators: two computed sines with the carrier frequency
+// reset from the modulator every sample (how FM rendered with gam::Sine),
+// against FMOperators, and the cost of FMOperators algorithms with more
+// operators.
+//
+// gam::Sine is stood in for by a phase accumulator and the same 7th-order
+// polynomial Gamma evaluates; freq() converts Hz to a phase increment every
+// call as gam::Sine::freq() does. The envelopes are left out of every case,
+// except that FMOperators renders 32-sample blocks with a new modulation
+// index for each, as the voice runs it.
+//
+// Also checks the sine table against sin() and a two-operator pair against
+// sin(wc t + I sin(wm t)) computed in double precision. Most of the pair's
+// error after a second is drift from rounding each frequency to a 32-bit
+// phase increment, well under 0.0001 Hz.
+//
+// build: g++ -O2 -std=c++17 fm_bench.cpp -o fm_bench
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "../fm_operators.h"
+#include "bench.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+static const int CTL_RATE = FM_BLOCK;
+
+class ComputedSine
+{
+private:
+    uint32_t mPhase = 0;
+    uint32_t mInc = 0;
+
+public:
+    void freq(float hz) { mInc = (uint32_t)(int64_t)(hz * (4294967296.0f / SAMPLE_RATE)); }
+
+    float operator()()
+    {
+        // phase to [-1, 1), then a 7th-order odd polynomial over a folded triangle
+        float x = (float)(int32_t)mPhase * (1.0f / 2147483648.0f);
+        mPhase += mInc;
+        float t = x < -0.5f ? -1.0f - x : x > 0.5f ? 1.0f - x : x;
+        t *= 3.14159265f;
+        float t2 = t * t;
+        return t * (1.0f + t2 * (-0.16666667f + t2 * (0.0083333331f + t2 * -0.00019841270f)));
+    }
+};
+
+static void benchAlgorithm(const char *name, const FMAlgorithm &algo)
+{
+    FMOperators ops(algo);
+    ops.sampleRate(SAMPLE_RATE);
+    for (int i = 0; i < algo.operators; i++)
+    {
+        ops.freq(i, 220.0f * (1 + i % 3) * 1.0007f);
+        ops.level(i, (algo.carriers & (1 << i)) ? 0.3f : 2.0f);
+    }
+    ops.feedback(0.5f);
+    ops.reset();
+    float block[CTL_RATE];
+    printBench(name, benchVoice(
+                         [&](long n) {
+                             float sum = 0.0f;
+                             for (long i = 0; i < n; i += CTL_RATE)
+                             {
+                                 for (int op = 1; op < algo.operators; op++)
+                                     if (!(algo.carriers & (1 << op)))
+                                         ops.level(op, 2.0f + (float)(i & 1023) * 0.001f);
+                                 ops.render(block);
+                                 for (int k = 0; k < CTL_RATE; k++)
+                                     sum += block[k];
+                             }
+                             doNotOptimize(sum);
+                         },
+                         (long)SAMPLE_RATE * 20, SAMPLE_RATE));
+}
+
+int main()
+{
+    const float freq = 440.0f, carMul = 1.0f, modMul = 1.0007f, index = 7.0f;
+
+    ComputedSine car, mod;
+    mod.freq(freq * modMul);
+    printBench("gam::Sine pair, freq() per sample", benchVoice(
+                                                         [&](long n) {
+                                                             float sum = 0.0f;
+                                                             for (long i = 0; i < n; i++)
+                                                             {
+                                                                 car.freq(freq * carMul + mod() * index * freq * modMul);
+                                                                 sum += car();
+                                                             }
+                                                             doNotOptimize(sum);
+                                                         },
+                                                         (long)SAMPLE_RATE * 20, SAMPLE_RATE));
+
+    benchAlgorithm("FMOperators FM_PAIR", FM_PAIR);
+    benchAlgorithm("FMOperators FM_STACK4", FM_STACK4);
+    benchAlgorithm("FMOperators FM_DX_BRASS (6 ops)", FM_DX_BRASS);
+    benchAlgorithm("FMOperators FM_THREE_PAIRS (6 ops)", FM_THREE_PAIRS);
+
+    // accuracy of the table
+    const SineTable &sine = sineTable();
+    double worst = 0.0;
+    for (uint64_t p = 0; p < (1ull << 32); p += 65537)
+    {
+        double err = std::fabs(sine((uint32_t)p) - std::sin(2.0 * M_PI * (double)p / 4294967296.0));
+        worst = err > worst ? err : worst;
+    }
+    std::printf("sine table worst error %.2e\n", worst);
+
+    // a pair against the formula over one second
+    FMOperators ops(FM_PAIR);
+    ops.sampleRate(SAMPLE_RATE);
+    ops.freq(0, freq * carMul);
+    ops.freq(1, freq * modMul);
+    ops.level(0, 1.0f);
+    ops.level(1, index);
+    ops.reset();
+    float block[CTL_RATE];
+    worst = 0.0;
+    for (int n = 0; n < (int)SAMPLE_RATE; n++)
+    {
+        if (n % CTL_RATE == 0)
+            ops.render(block);
+        double t = n / (double)SAMPLE_RATE;
+        double exact = std::sin(2.0 * M_PI * freq * carMul * t + index * std::sin(2.0 * M_PI * freq * modMul * t));
+        double err = std::fabs(block[n % CTL_RATE] - exact);
+        worst = err > worst ? err : worst;
+    }
+    std::printf("FM_PAIR worst error against sin(wc t + I sin(wm t)) over 1 s: %.2e\n", worst);
+    return 0;
+}
@@ -0,0 +1,250 @@
+// Timing jitter of note starts and releases, with and without splitting
+// the audio block at each event.
+//
+// Renders click trains (sixteenth notes, half a step long) at several
+// tempos in 512-frame blocks, driving the voices from an EventScheduler the
+// way NoteEngine::beginBlock() does, and finds where each note really
+// started and released in the output. Reports the mean and worst error in
+// samples against the ideal frame round(t * sampleRate), next to the same
+// train applied at block boundaries only.
+//
+// "gate" is a voice whose output is 1 while its note is on. It releases
+// through the same ReleaseSplit the demo voices' renderAudio() splits its
+// loop with, and events reach it through blockOffset() as in beginBlock().
+// "bank" is MiniSubBank with startAt() and noteOffAt(), where the release
+// is found by diffing against the same note held on.
+//
+// build: g++ -O2 -std=c++17 jitter_test.cpp -o jitter_test
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../event_scheduler.h"
+#include "../minisub_bank.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+static const int BLOCK = 512;
+static const int NUM_NOTES = 256;
+
+static WavetableBank tables; // the bank's oscillators, built in main()
+
+struct Event
+{
+    enum Type
+    {
+        NOTE_ON,
+        NOTE_RELEASE
+    };
+    Type type;
+    int note;
+    uint64_t duration; // frames, NOTE_ON only
+};
+
+struct Patch
+{
+    float amplitude = 0.5f, frequency = 220.0f, oscMix = 0.5f, noise = 0.0f, pan = 0.0f;
+    float ampEnvAtk = 0.002f, ampEnvDec = 0.05f, ampEnvSus = 0.7f, ampEnvRel = 0.05f, ampEnvCve = 4.0f;
+    float filtEnvAtk = 0.01f, filtEnvDec = 0.05f, filtEnvSus = 0.5f, filtEnvRel = 0.05f, filtEnvCve = 4.0f;
+    // no filter sweep: the bank interpolates filter coefficients across each
+    // sub-block, so a sweep would make a released note differ from a held
+    // one slightly before the release lands
+    float filtEnvDpth = 0.0f, filtFreq = 1200.0f, filtRes = 0.5f;
+};
+
+struct Stats
+{
+    double sum = 0.0;
+    long worst = 0;
+    int count = 0;
+
+    void add(long error)
+    {
+        error = std::labs(error);
+        sum += error;
+        worst = error > worst ? error : worst;
+        count++;
+    }
+};
+
+// Output is 1 while the note is on. It starts at its trigger offset, as
+// VoicePlayer starts a voice, and releases with ReleaseSplit exactly as the
+// demo voices' render loops do.
+struct GateVoice
+{
+    bool on = false;
+    int startOffset = -1;
+    ReleaseSplit release;
+
+    void releaseAt(int offset) { release.at(offset); }
+
+    void render(float *out, int frames)
+    {
+        release.beginBlock();
+        for (int i = 0; i < frames; i++)
+        {
+            if (i == startOffset)
+                on = true;
+            if (release.due(i))
+                on = false; // split the block at the release
+            out[i] += on ? 1.0f : 0.0f;
+        }
+        startOffset = -1;
+    }
+};
+
+// Ideal start and length of each note of a sixteenth-note train at bpm
+static void clickTrain(float bpm, std::vector<uint64_t> &start, std::vector<uint64_t> &length)
+{
+    double step = 60.0 / bpm / 4.0;
+    start.resize(NUM_NOTES);
+    length.resize(NUM_NOTES);
+    for (int i = 0; i < NUM_NOTES; i++)
+    {
+        // an odd offset so steps don't all land on a block boundary
+        start[i] = (uint64_t)std::llround((0.0131 + i * step) * SAMPLE_RATE);
+        length[i] = (uint64_t)std::llround(step * 0.5 * SAMPLE_RATE);
+    }
+}
+
+// Drive a gate voice per note from the scheduler; quantize applies every
+// event at the start of the block it falls in. Returns the rendered output.
+static std::vector<float> renderGates(const std::vector<uint64_t> &start, const std::vector<uint64_t> &length,
+                                      bool quantize)
+{
+    static EventScheduler<Event, 2 * NUM_NOTES> scheduler;
+    scheduler.clear();
+    for (int i = 0; i < NUM_NOTES; i++)
+        scheduler.schedule(start[i], {Event::NOTE_ON, i, length[i]});
+
+    std::vector<GateVoice> voices(NUM_NOTES);
+    uint64_t total = start.back() + length.back() + 2 * BLOCK;
+    std::vector<float> out((total / BLOCK + 1) * BLOCK, 0.0f);
+    for (uint64_t blockStart = 0; blockStart < total; blockStart += BLOCK)
+    {
+        uint64_t frame;
+        Event e;
+        while (scheduler.next(blockStart + BLOCK, frame, e))
+        {
+            int offset = quantize ? 0 : blockOffset(frame, blockStart);
+            GateVoice &v = voices[e.note];
+            if (e.type == Event::NOTE_ON)
+            {
+                v.startOffset = offset;
+                scheduler.schedule(blockStart + offset + e.duration, {Event::NOTE_RELEASE, e.note, 0});
+            }
+            else
+                v.releaseAt(offset);
+        }
+        for (GateVoice &v : voices)
+            v.render(&out[blockStart], BLOCK);
+    }
+    return out;
+}
+
+static void measureGates(const std::vector<float> &out, const std::vector<uint64_t> &start,
+                         const std::vector<uint64_t> &length, Stats &onsets, Stats &releases)
+{
+    // notes don't overlap, so every rising edge is a start and every
+    // falling edge a release, in note order
+    int on = 0, off = 0;
+    for (size_t i = 1; i < out.size(); i++)
+    {
+        if (out[i] > 0.5f && out[i - 1] < 0.5f && on < NUM_NOTES)
+        {
+            onsets.add((long)i - (long)start[on]);
+            on++;
+        }
+        if (out[i] < 0.5f && out[i - 1] > 0.5f && off < NUM_NOTES)
+        {
+            releases.add((long)i - (long)(start[off] + length[off]));
+            off++;
+        }
+    }
+}
+
+// Play one note through a MiniSubBank in blocks, released with noteOffAt()
+// (or held on if release is false); returns the left channel
+static std::vector<float> renderBankNote(uint64_t start, uint64_t length, bool release, bool quantize)
+{
+    static MiniSubBank<8> bank;
+    Patch patch;
+    int lane = bank.acquire();
+    uint64_t total = start + length + (uint64_t)(0.2f * SAMPLE_RATE);
+    std::vector<float> left((total / BLOCK + 1) * BLOCK, 0.0f), right(left.size(), 0.0f);
+    for (uint64_t blockStart = 0; blockStart < total; blockStart += BLOCK)
+    {
+        uint64_t end = blockStart + BLOCK;
+        if (start >= blockStart && start < end)
+        {
+            bank.noteOn(lane, patch, tables);
+            bank.startAt(lane, quantize ? 0 : (int)(start - blockStart));
+        }
+        uint64_t releaseFrame = (quantize ? start / BLOCK * BLOCK : start) + length;
+        if (release && releaseFrame >= blockStart && releaseFrame < end)
+            bank.noteOffAt(lane, quantize ? 0 : (int)(releaseFrame - blockStart));
+        bank.render(&left[blockStart], &right[blockStart], BLOCK);
+    }
+    bank.release(lane);
+    return left;
+}
+
+static void measureBank(const std::vector<uint64_t> &start, const std::vector<uint64_t> &length, bool quantize,
+                        Stats &onsets, Stats &releases)
+{
+    // one note at a time: 32 notes of the train are plenty here
+    for (int i = 0; i < 32; i++)
+    {
+        std::vector<float> released = renderBankNote(start[i], length[i], true, quantize);
+        std::vector<float> held = renderBankNote(start[i], length[i], false, quantize);
+        // a note starts at phase 0, where the tables read 0, so its first
+        // sample is silent and its second is not
+        size_t first = 0, split = 0;
+        while (first < held.size() && held[first] == 0.0f)
+            first++;
+        first--;
+        while (split < held.size() && held[split] == released[split])
+            split++;
+        onsets.add((long)first - (long)start[i]);
+        releases.add((long)split - (long)(start[i] + length[i]));
+    }
+}
+
+static void report(const char *name, const Stats &s)
+{
+    std::printf("  %-8s mean %7.2f  max %4ld", name, s.sum / s.count, s.worst);
+}
+
+int main()
+{
+    tables.build(SAMPLE_RATE);
+    const float tempos[] = {60.0f, 97.0f, 120.0f, 133.0f, 174.0f};
+
+    std::printf("%d-frame blocks at %.0f Hz, error in samples (0 is sample-accurate)\n\n", BLOCK, SAMPLE_RATE);
+    bool exact = true;
+    for (float bpm : tempos)
+    {
+        std::vector<uint64_t> start, length;
+        clickTrain(bpm, start, length);
+        for (int quantize = 0; quantize < 2; quantize++)
+        {
+            Stats gateOn, gateOff, bankOn, bankOff;
+            measureGates(renderGates(start, length, quantize), start, length, gateOn, gateOff);
+            measureBank(start, length, quantize, bankOn, bankOff);
+
+            std::printf("%5.0f bpm %-9s gate", bpm, quantize ? "block" : "split");
+            report("start", gateOn);
+            report("release", gateOff);
+            std::printf("\n%20s bank", "");
+            report("start", bankOn);
+            report("release", bankOff);
+            std::printf("\n");
+            if (!quantize && (gateOn.worst || gateOff.worst || bankOn.worst || bankOff.worst))
+                exact = false;
+        }
+    }
+    std::printf("\n%s\n", exact ? "split: every start and release on its sample" : "split: TIMING ERRORS");
+    return exact ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// Cost of a KPSWaves note with the excitation running for the whole note
+// (INSTR_KPS) against pluck mode (INSTR_PLUCK), where a short burst is fed
+// to the comb and then only the damped loop runs.
+//
+// The voice loop is rebuilt from the same parts the demo uses (WavetableOsc,
+// BlockNoise, BlockBiquad, FixedComb); the envelopes are plain ramps rather
+// than gam::ADSR, so they cost the same in both modes. Each note lasts one
+// second, as in the demo's --bench.
+//
+// build: g++ -O2 -std=c++17 kps_pluck_bench.cpp -o kps_pluck_bench
+
+#include <cmath>
+#include <cstdio>
+
+#include "../block_biquad.h"
+#include "../block_noise.h"
+#include "../fixed_comb.h"
+#include "../wavetable.h"
+#include "bench.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+static const int CTL_RATE = 32;
+
+struct String
+{
+    WavetableOsc osc;
+    BlockNoise noise;
+    BlockBiquad filter{CTL_RATE};
+    FixedComb comb;
+    float env = 0.0f, filtEnv = 0.0f;
+    int exciteLeft = -1;
+
+    // pluck seconds of excitation, 0 for all of it; damp for the loop
+    void start(const WavetableBank &tables, float freq, float pluck, float damp, uint32_t stream)
+    {
+        osc.freq(tables, freq);
+        noise.seed(1, stream);
+        filter.sampleRate(SAMPLE_RATE);
+        filter.res(0.1f);
+        filter.reset();
+        comb.sampleRate(SAMPLE_RATE);
+        comb.reset();
+        comb.damping(damp);
+        comb.delaySamples(SAMPLE_RATE / freq);
+        comb.decay(0.6f);
+        env = filtEnv = 0.0f;
+        exciteLeft = pluck > 0.0f ? (int)std::lround(pluck * SAMPLE_RATE) : -1;
+    }
+
+    float operator()()
+    {
+        float s = 0.0f;
+        if (exciteLeft != 0)
+        {
+            if (exciteLeft > 0)
+                exciteLeft--;
+            s = osc.mix(0.23f) * 0.004f + noise() * 0.996f;
+            filtEnv += (1.0f - filtEnv) * 0.0005f;
+            filter.freq(926.0f + filtEnv * 1032.0f);
+            s = filter(s);
+        }
+        s = comb(s);
+        env += (1.0f - env) * 0.001f;
+        return s * env * 0.3f;
+    }
+};
+
+static void benchMode(const char *name, const WavetableBank &tables, float pluck, float damp)
+{
+    String string;
+    string.comb.capacity(1.0f / 20.0f, SAMPLE_RATE);
+    string.comb.ipolType(COMB_LAGRANGE);
+    uint32_t stream = 0;
+    printBench(name, benchVoice(
+                         [&](long numSamples) {
+                             float sum = 0.0f;
+                             for (long done = 0; done < numSamples; done += (long)SAMPLE_RATE)
+                             {
+                                 string.start(tables, 110.0f * (1 + stream % 8), pluck, damp, stream);
+                                 stream++;
+                                 for (long i = 0; i < (long)SAMPLE_RATE; i++)
+                                     sum += string();
+                             }
+                             doNotOptimize(sum);
+                         },
+                         (long)SAMPLE_RATE * 8, SAMPLE_RATE));
+}
+
+int main()
+{
+    WavetableBank tables;
+    tables.build(SAMPLE_RATE);
+
+    benchMode("excite whole note (INSTR_KPS)", tables, 0.0f, 0.0f);
+    benchMode("pluck 20 ms", tables, 0.02f, 0.35f);
+    benchMode("pluck 5 ms (INSTR_PLUCK)", tables, 0.005f, 0.35f);
+    benchMode("pluck 5 ms, undamped loop", tables, 0.005f, 0.0f);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Tuning accuracy and cost of the Karplus-Strong comb across the MIDI range,
+// for each FixedComb interpolation mode.
+//
+// For each note, measures the delay the comb really applies at the note
+// frequency (which sets the pitch of the Karplus-Strong loop) and reports the
+// mean and worst error in cents, plus ns/sample per voice. The comb here has
+// no loop filter, so the error is down to the interpolation alone.
+//
+// build: g++ -O2 -std=c++17 kps_tuning.cpp -o kps_tuning
+
+#include <cmath>
+#include <cstdio>
+
+#include "../fixed_comb.h"
+#include "bench.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+
+static double midiToFreq(int note) { return 440.0 * std::pow(2.0, (note - 69) / 12.0); }
+
+// Measure the delay the comb actually applies at freq, in samples.
+// With feedback off the comb output is just the interpolated delay line
+// read, so driving it with a sine and measuring the phase of the output
+// against a sine delayed by the nominal amount gives the error directly.
+// The sounding fundamental of a Karplus-Strong loop is sampleRate / delay.
+static double measureDelay(FixedComb &comb, double freq, int numSamples)
+{
+    double nominal = SAMPLE_RATE / freq;
+    double w = 2.0 * M_PI * freq / SAMPLE_RATE;
+    comb.reset();
+    comb.fbk(0.0f);
+    comb.ffd(0.0f);
+    comb.delaySamples((float)nominal);
+
+    double re = 0.0, im = 0.0;
+    int skip = (int)nominal + 8;
+    for (int i = 0; i < numSamples; i++)
+    {
+        float out = comb((float)std::sin(w * i));
+        if (i >= skip)
+        {
+            // correlate against the input delayed by the nominal amount,
+            // Hann windowed so a partial last cycle doesn't bias the phase
+            double win = 0.5 - 0.5 * std::cos(2.0 * M_PI * (i - skip) / (numSamples - skip));
+            re += win * out * std::sin(w * (i - nominal));
+            im += win * out * std::cos(w * (i - nominal));
+        }
+    }
+    // a positive phase means the output leads, i.e. less delay than asked for
+    return nominal - std::atan2(im, re) / w;
+}
+
+int main()
+{
+    const CombInterp modes[] = {COMB_LINEAR, COMB_ALLPASS, COMB_LAGRANGE};
+    const char *names[] = {"linear", "allpass", "lagrange"};
+    const int firstNote = 28, lastNote = 108; // E1 to C8
+    const int numSamples = 16384;
+
+    std::printf("MIDI %d-%d at %.0f Hz\n", firstNote, lastNote, SAMPLE_RATE);
+    for (int m = 0; m < 3; m++)
+    {
+        FixedComb comb;
+        comb.capacity(1.0f / 20.0f, SAMPLE_RATE);
+        comb.sampleRate(SAMPLE_RATE);
+        comb.ipolType(modes[m]);
+
+        double worst = 0.0, total = 0.0;
+        int worstNote = firstNote;
+        for (int note = firstNote; note <= lastNote; note++)
+        {
+            double freq = midiToFreq(note);
+            double delay = measureDelay(comb, freq, numSamples);
+            double cents = std::fabs(1200.0 * std::log2((SAMPLE_RATE / delay) / freq));
+            total += cents;
+            if (cents > worst)
+                worst = cents, worstNote = note;
+        }
+
+        comb.fbk(0.99f);
+        comb.delaySamples(SAMPLE_RATE / 220.0f);
+        BenchResult r = benchVoice(
+            [&](long n) {
+                // keep feeding a little noise so the loop never decays into
+                // denormals, which would swamp the measurement
+                float sum = 0.0f;
+                unsigned seed = 1;
+                for (long i = 0; i < n; i++)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    sum += comb((float)(seed >> 8) * 1e-9f);
+                }
+                doNotOptimize(sum);
+            },
+            (long)SAMPLE_RATE * 10, SAMPLE_RATE);
+
+        printBench(names[m], r);
+        std::printf("%-40s mean error %.4f cents, worst %.4f cents (MIDI %d)\n", "",
+                    total / (lastNote - firstNote + 1), worst, worstNote);
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Renders 64 MiniSubWaves-style notes through MiniSubBank at each lane
+// width. Width 1 is plain scalar code, one voice at a time.
+//
+// build: g++ -O3 -march=native -std=c++17 minisub_bank_bench.cpp -o minisub_bank_bench
+
+#include <cstdio>
+#include <vector>
+
+#include "../minisub_bank.h"
+#include "bench.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+static const int BLOCK = 512;
+static const int NUM_NOTES = 64;
+
+static WavetableBank tables; // the bank's oscillators, built in main()
+
+// the INSTR_MSCHORDS patch
+struct ChordParams
+{
+    float amplitude = 0.3f, frequency = 220.0f, oscMix = 0.1f, noise = 0.0f, pan = 0.0f;
+    float ampEnvAtk = 0.1f, ampEnvDec = 0.3f, ampEnvSus = 0.6f, ampEnvRel = 0.2f, ampEnvCve = 4.0f;
+    float filtEnvAtk = 0.25f, filtEnvDec = 0.2f, filtEnvSus = 0.05f, filtEnvRel = 0.1f, filtEnvCve = 1.0f;
+    float filtEnvDpth = 1800.0f, filtFreq = 1150.0f, filtRes = 1.0f;
+};
+
+template <int W>
+void benchWidth()
+{
+    static MiniSubBank<W, NUM_NOTES> bank;
+    std::vector<float> left(BLOCK), right(BLOCK);
+
+    BenchResult r = benchVoice(
+        [&](long numSamples) {
+            ChordParams p;
+            int lanes[NUM_NOTES];
+            for (int i = 0; i < NUM_NOTES; i++)
+            {
+                p.frequency = 100.0f + i * 13.0f;
+                lanes[i] = bank.acquire();
+                bank.noteOn(lanes[i], p, tables);
+                bank.startAt(lanes[i], i % BLOCK);
+            }
+            for (long done = 0; done < numSamples; done += BLOCK)
+            {
+                bank.render(left.data(), right.data(), BLOCK);
+                doNotOptimize(left[0]);
+            }
+            for (int i = 0; i < NUM_NOTES; i++)
+                bank.release(lanes[i]);
+        },
+        (long)SAMPLE_RATE * 4 / NUM_NOTES * NUM_NOTES, SAMPLE_RATE);
+
+    // benchVoice timed all the notes together; report per voice
+    r.nsPerSample /= NUM_NOTES;
+    r.voicesPerCore *= NUM_NOTES;
+    char name[64];
+    std::snprintf(name, sizeof(name), "%d lanes%s", W, W == 1 ? " (scalar)" : "");
+    printBench(name, r);
+}
+
+int main()
+{
+    tables.build(SAMPLE_RATE);
+    std::printf("%d notes, %d-frame blocks at %.0f Hz\n", NUM_NOTES, BLOCK, SAMPLE_RATE);
+    benchWidth<1>();
+    benchWidth<4>();
+    benchWidth<8>();
+    benchWidth<16>();
+    return 0;
+}
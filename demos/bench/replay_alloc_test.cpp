@@ -0,0 +1,138 @@
+// Checks that replaying a song never touches the heap: builds a phrase
+// tree through a PhraseCache the way the Grumpy demos build their songs,
+// and a sorted .gseq file, then plays both through a NoteFeed several
+// times, counting heap allocations with alloc_counter.h. The first play
+// may allocate (phrases are built and sorted then); every replay must not.
+//
+// Also streams a tree with more parts sounding at once than a NoteStream
+// keeps inline, which has to allocate but must still play every note in
+// order. Exits non-zero on any failure, or if the counter isn't counting.
+//
+// build: g++ -O2 -std=c++17 replay_alloc_test.cpp -o replay_alloc_test
+
+#define COUNT_ALLOCS
+#include "../alloc_counter.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "../note_feed.h"
+#include "../sequence.h"
+#include "../sequence_file.h"
+#include "bench.h"
+
+static const double SAMPLE_RATE = 48000.0;
+static const int BLOCK = 512;
+static const int REPLAYS = 5;
+static const char *FILE_PATH = "replay_alloc_test.gseq";
+
+enum Phrase
+{
+    PHRASE_SONG,
+    PHRASE_CHORDS,
+    PHRASE_BASS
+};
+
+// the song, built on the first call and found in the cache after
+static Sequence *song(PhraseCache &phrases)
+{
+    if (Sequence *s = phrases.find(PHRASE_SONG))
+        return s;
+    Sequence *chords = phrases.create(PHRASE_CHORDS);
+    for (int i = 0; i < 5; i++)
+    {
+        chords->add(Note(440.0f + i, i * 0.5f, 0.5f, 0.3f));
+        chords->add(Note(660.0f + i, i * 0.5f, 0.5f, 0.3f));
+    }
+    Sequence *bass = phrases.create(PHRASE_BASS);
+    for (int i = 0; i < 4; i++)
+        bass->add(Note(110.0f, 3.0f - i, 1.0f, 0.5f)); // added out of order
+    Sequence *s = phrases.create(PHRASE_SONG);
+    s->addPhrase(chords, 0.0f, 1.0f, 8, 3.5f);
+    s->addPhrase(bass, 0.0f, 1.0f, 8, 3.5f);
+    return s;
+}
+
+// Play everything added to feed to the end, a block at a time; returns the
+// notes played
+static long play(NoteFeed &feed)
+{
+    long notes = 0;
+    uint64_t frame = 0;
+    while (!feed.empty())
+    {
+        frame += BLOCK;
+        feed.feed(frame, SAMPLE_RATE, [&](const FedNote &n) {
+            doNotOptimize(n.freq);
+            notes++;
+            return true;
+        });
+    }
+    return notes;
+}
+
+int main()
+{
+    long before = threadAllocCount();
+    {
+        std::vector<float> probe(16);
+        doNotOptimize(probe.data());
+    }
+    if (threadAllocCount() == before)
+    {
+        std::printf("allocation counter is not counting\n");
+        return 1;
+    }
+
+    PhraseCache phrases;
+    NoteFeed feed;
+    bool failed = false;
+
+    std::vector<PackedNote> packed;
+    packSequence(*song(phrases), 0, packed);
+    const char *names[] = {"CHORDS"};
+    MappedSequence file;
+    if (!writeSequenceFile(FILE_PATH, packed.data(), (int)packed.size(), 120.0f, names, 1) || !file.open(FILE_PATH))
+    {
+        std::printf("can't write %s\n", FILE_PATH);
+        return 1;
+    }
+    const int instruments[] = {0};
+
+    for (int i = 0; i <= REPLAYS; i++)
+    {
+        long start = threadAllocCount();
+        feed.add(song(phrases), 120.0f, 0, 0);
+        feed.add(file, instruments, 120.0f, 0);
+        long notes = play(feed);
+        long n = threadAllocCount() - start;
+        std::printf("%-8s %ld notes, %ld allocations\n", i == 0 ? "play" : "replay", notes, n);
+        failed |= i > 0 && n > 0;
+    }
+    file.close();
+    std::remove(FILE_PATH);
+
+    // more parts starting together than the stream keeps inline
+    SequenceArena arena;
+    Sequence *note = arena.make<Sequence>(TimeSignature(), &arena);
+    note->add(Note(220.0f, 0.0f, 1.0f, 0.1f));
+    Sequence *wide = arena.make<Sequence>(TimeSignature(), &arena);
+    for (int i = 0; i < 3 * NOTE_STREAM_CURSORS; i++)
+        wide->addPhrase(note, (i % 3) * 0.25f, 1.0f, 2, 1.0f);
+    NoteStream stream(wide);
+    Note n;
+    long count = 0;
+    float last = 0.0f;
+    bool ordered = true;
+    while (stream.next(n))
+    {
+        ordered &= n.getTime() >= last;
+        last = n.getTime();
+        count++;
+    }
+    std::printf("wide tree: %ld of %ld notes%s\n", count, wide->noteCount(), ordered ? "" : ", OUT OF ORDER");
+    failed |= count != wide->noteCount() || !ordered;
+
+    std::printf("\n%s\n", failed ? "FAILED" : "no heap allocations on replay");
+    return failed ? 1 : 0;
+}
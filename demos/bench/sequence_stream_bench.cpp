@@ -0,0 +1,87 @@
+// Building and playing a long song from a phrase: copied into the song with
+// addSequence() for every repeat, against one addPhrase() part streamed
+// with NoteStream.
+//
+// Reports the arena memory each song takes and the time to build it and to
+// walk every note in time order (the eager song is sorted first, since its
+// copies needn't be in order).
+//
+// build: g++ -O2 -std=c++17 sequence_stream_bench.cpp -o sequence_stream_bench
+
+#include <chrono>
+#include <cstdio>
+
+#include "../sequence.h"
+#include "bench.h"
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the sequenceGH_ChordsPhrase1 rhythm: pairs of notes every half beat
+static Sequence *makePhrase(SequenceArena &arena)
+{
+    Sequence *s = arena.make<Sequence>(TimeSignature(), &arena);
+    for (int i = 0; i < 5; i++)
+    {
+        s->add(Note(440.0f + i, i * 0.5f, 0.5f, 0.3f));
+        s->add(Note(660.0f + i, i * 0.5f, 0.5f, 0.3f));
+    }
+    return s;
+}
+
+static void run(int repeats)
+{
+    std::printf("%d repeats (%d notes)\n", repeats, repeats * 10);
+
+    {
+        SequenceArena arena;
+        Sequence *phrase = makePhrase(arena);
+        auto start = std::chrono::steady_clock::now();
+        Sequence *song = arena.make<Sequence>(TimeSignature(), &arena);
+        for (int r = 0; r < repeats; r++)
+            song->addSequence(phrase, r * 3.5f);
+        double build = msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        const int *order = song->order();
+        float sum = 0.0f;
+        for (int i = 0; i < song->size(); i++)
+            sum += song->getNotes().time[order[i]];
+        doNotOptimize(sum);
+        std::printf("  %-22s %10zu bytes  build %8.3f ms  play %8.3f ms\n", "addSequence (eager)",
+                    arena.bytesReserved(), build, msSince(start));
+    }
+
+    {
+        SequenceArena arena;
+        Sequence *phrase = makePhrase(arena);
+        auto start = std::chrono::steady_clock::now();
+        Sequence *song = arena.make<Sequence>(TimeSignature(), &arena);
+        song->addPhrase(phrase, 0.0f, 1.0f, repeats, 3.5f);
+        double build = msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        NoteStream notes(song);
+        Note n;
+        float sum = 0.0f;
+        long count = 0;
+        while (notes.next(n))
+        {
+            sum += n.getTime();
+            count++;
+        }
+        doNotOptimize(sum);
+        std::printf("  %-22s %10zu bytes  build %8.3f ms  play %8.3f ms  (%ld notes)\n", "addPhrase + NoteStream",
+                    arena.bytesReserved(), build, msSince(start), count);
+    }
+}
+
+int main()
+{
+    run(100);
+    run(10000);
+    run(100000);
+    return 0;
+}
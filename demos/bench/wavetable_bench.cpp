@@ -0,0 +1,319 @@
+// Wavetable oscillators against the per-sample oscillators they replace.
+//
+// Times saw, square and the MiniSubWaves saw/square mix, then measures
+// aliasing: each oscillator renders a steady note, a Blackman-Harris
+// windowed DFT splits its energy into bins on the note's harmonics and the
+// rest, and the rest is reported in dB relative to the harmonics. Ds6 is
+// the top note of sequenceGH_ChordsPhrase1.
+//
+// The Gamma oscillators are stood in for by the same algorithms, so this
+// builds without Gamma: gam::Saw sums the harmonics up to Nyquist in closed
+// form (a band-limited impulse train, leakily integrated), and gam::DWO's
+// sqr() is a differentiated parabolic wave (DPW). "naive" is a plain phase
+// ramp, for scale. "MiniSubBank" is a note rendered by the bank the demos
+// play MiniSubWaves notes through, with its filter opened up.
+//
+// build: g++ -O2 -std=c++17 wavetable_bench.cpp -o wavetable_bench
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "../minisub_bank.h"
+#include "../wavetable.h"
+#include "bench.h"
+
+static const float SAMPLE_RATE = 48000.0f;
+static const float OSC_MIX = 0.1f; // the INSTR_MSCHORDS patch
+static const int DFT_SIZE = 8192;
+
+// Band-limited saw: the integral of sum_k cos(k x) for k up to Nyquist,
+// computed with the closed form sin((N + 1/2) x) / (2 sin(x / 2)) - 1/2
+class BuzzSaw
+{
+private:
+    double mPhase = 0.0, mInc = 0.0, mSum = 0.0;
+    int mHarmonics = 1;
+
+public:
+    void freq(float f)
+    {
+        mInc = 2.0 * M_PI * f / SAMPLE_RATE;
+        mHarmonics = (int)(0.5f * SAMPLE_RATE / f);
+    }
+
+    float operator()()
+    {
+        double s = std::sin(0.5 * mPhase);
+        double buzz = std::fabs(s) < 1e-9 ? mHarmonics : std::sin((mHarmonics + 0.5) * mPhase) / (2.0 * s) - 0.5;
+        mSum = 0.9995 * mSum + buzz * mInc; // leaky, to keep DC from wandering
+        mPhase += mInc;
+        if (mPhase >= 2.0 * M_PI)
+            mPhase -= 2.0 * M_PI;
+        return (float)(mSum * (2.0 / M_PI));
+    }
+};
+
+// DPW saw and square: differentiate the square of a naive ramp, and
+// subtract two such saws half a cycle apart for the square
+class DpwOsc
+{
+private:
+    float mPhase = 0.0f, mInc = 0.0f, mScale = 1.0f, mPrev0 = 0.0f, mPrev1 = 0.0f;
+
+    static float wrap(float p) { return p >= 1.0f ? p - 2.0f : p; }
+
+public:
+    void freq(float f)
+    {
+        mInc = 2.0f * f / SAMPLE_RATE;
+        mScale = 1.0f / (4.0f * mInc);
+    }
+
+    float saw()
+    {
+        mPhase = wrap(mPhase + mInc);
+        float p0 = mPhase * mPhase;
+        float s = (p0 - mPrev0) * mScale;
+        mPrev0 = p0;
+        return s;
+    }
+
+    float sqr()
+    {
+        mPhase = wrap(mPhase + mInc);
+        float half = wrap(mPhase + 1.0f);
+        float p0 = mPhase * mPhase, p1 = half * half;
+        float s = ((p0 - mPrev0) - (p1 - mPrev1)) * mScale;
+        mPrev0 = p0;
+        mPrev1 = p1;
+        return s;
+    }
+};
+
+class NaiveOsc
+{
+private:
+    float mPhase = 0.0f, mInc = 0.0f;
+
+public:
+    void freq(float f) { mInc = f / SAMPLE_RATE; }
+
+    float saw()
+    {
+        mPhase += mInc;
+        mPhase -= mPhase >= 1.0f ? 1.0f : 0.0f;
+        return 2.0f * mPhase - 1.0f;
+    }
+
+    float sqr()
+    {
+        mPhase += mInc;
+        mPhase -= mPhase >= 1.0f ? 1.0f : 0.0f;
+        return mPhase < 0.5f ? 1.0f : -1.0f;
+    }
+};
+
+// A MiniSubBank lane holding one note of shape (oscMix 0 is saw, 1 is
+// square), with the envelopes at full level and the filter far enough
+// above the note's harmonics to leave them alone
+class BankOsc
+{
+private:
+    struct Note
+    {
+        float amplitude = 1.0f, frequency = 220.0f, oscMix = 0.0f, noise = 0.0f, pan = 0.0f;
+        float ampEnvAtk = 0.001f, ampEnvDec = 0.001f, ampEnvSus = 1.0f, ampEnvRel = 0.1f, ampEnvCve = 0.0f;
+        float filtEnvAtk = 0.001f, filtEnvDec = 0.001f, filtEnvSus = 1.0f, filtEnvRel = 0.1f, filtEnvCve = 0.0f;
+        float filtEnvDpth = 0.0f, filtFreq = 20000.0f, filtRes = 0.707f;
+    };
+    static const int BLOCK = 256;
+
+    std::shared_ptr<MiniSubBank<8, 8>> mBank = std::make_shared<MiniSubBank<8, 8>>();
+    std::vector<float> mLeft = std::vector<float>(BLOCK), mRight = std::vector<float>(BLOCK);
+    int mNext = BLOCK;
+
+public:
+    BankOsc(const WavetableBank &tables, float freq, float oscMix)
+    {
+        Note note;
+        note.frequency = freq;
+        note.oscMix = oscMix;
+        int lane = mBank->acquire();
+        mBank->noteOn(lane, note, tables);
+        mBank->startAt(lane, 0);
+    }
+
+    float operator()()
+    {
+        if (mNext == BLOCK)
+        {
+            std::fill(mLeft.begin(), mLeft.end(), 0.0f);
+            std::fill(mRight.begin(), mRight.end(), 0.0f);
+            mBank->render(mLeft.data(), mRight.data(), BLOCK);
+            mNext = 0;
+        }
+        return mLeft[mNext++];
+    }
+};
+
+template <class Gen>
+void benchOsc(const char *name, Gen gen)
+{
+    printBench(name, benchVoice(
+                         [&](long numSamples) {
+                             float sum = 0.0f;
+                             for (long i = 0; i < numSamples; i++)
+                                 sum += gen();
+                             doNotOptimize(sum);
+                         },
+                         (long)SAMPLE_RATE * 10, SAMPLE_RATE));
+}
+
+// Energy off the harmonics of freq over energy on them, in dB
+template <class Gen>
+double aliasDb(float freq, Gen gen)
+{
+    for (int i = 0; i < DFT_SIZE; i++) // settle integrators and filters
+        gen();
+    std::vector<double> x(DFT_SIZE);
+    for (int i = 0; i < DFT_SIZE; i++)
+    {
+        double t = 2.0 * M_PI * i / (DFT_SIZE - 1);
+        double w = 0.35875 - 0.48829 * std::cos(t) + 0.14128 * std::cos(2 * t) - 0.01168 * std::cos(3 * t);
+        x[i] = gen() * w;
+    }
+
+    const double binHz = SAMPLE_RATE / DFT_SIZE;
+    const int LOBE = 5; // Blackman-Harris main lobe half-width, in bins
+    double on = 0.0, off = 0.0;
+    for (int k = 1; k < DFT_SIZE / 2; k++)
+    {
+        // one DFT bin, by rotating the twiddle instead of calling sin per sample
+        double c = std::cos(2.0 * M_PI * k / DFT_SIZE), s = -std::sin(2.0 * M_PI * k / DFT_SIZE);
+        double wr = 1.0, wi = 0.0, re = 0.0, im = 0.0;
+        for (int i = 0; i < DFT_SIZE; i++)
+        {
+            re += x[i] * wr;
+            im += x[i] * wi;
+            double next = wr * c - wi * s;
+            wi = wr * s + wi * c;
+            wr = next;
+        }
+        double power = re * re + im * im;
+        if (k * binHz < 0.5 * freq)
+            continue; // DC and slow drift are not aliasing
+        double harmonic = k * binHz / freq;
+        bool onHarmonic = std::fabs(harmonic - std::round(harmonic)) * freq < LOBE * binHz && std::round(harmonic) >= 1;
+        (onHarmonic ? on : off) += power;
+    }
+    return 10.0 * std::log10(off / on);
+}
+
+int main()
+{
+    WavetableBank tables;
+    tables.build(SAMPLE_RATE);
+
+    const float f = 220.0f;
+    std::printf("Cost at %.0f Hz, %.0f Hz sample rate\n", f, SAMPLE_RATE);
+    {
+        NaiveOsc o;
+        o.freq(f);
+        benchOsc("naive saw", [&] { return o.saw(); });
+    }
+    {
+        BuzzSaw o;
+        o.freq(f);
+        benchOsc("band-limited saw (gam::Saw)", [&] { return o(); });
+    }
+    {
+        DpwOsc o;
+        o.freq(f);
+        benchOsc("DPW square (gam::DWO::sqr)", [&] { return o.sqr(); });
+    }
+    {
+        BuzzSaw saw;
+        DpwOsc sqr;
+        saw.freq(f);
+        sqr.freq(f);
+        benchOsc("saw/square mix (gam::Saw + gam::DWO)",
+                 [&] { return saw() * (1 - OSC_MIX) + sqr.sqr() * OSC_MIX; });
+    }
+    {
+        WavetableOsc o;
+        o.freq(tables, f);
+        benchOsc("wavetable saw", [&] { return o.saw(); });
+    }
+    {
+        WavetableOsc o;
+        o.freq(tables, f);
+        benchOsc("wavetable square", [&] { return o.square(); });
+    }
+    {
+        WavetableOsc o;
+        o.freq(tables, f);
+        benchOsc("wavetable saw/square mix", [&] { return o.mix(OSC_MIX); });
+    }
+
+    struct Note
+    {
+        const char *name;
+        float freq;
+    };
+    const Note notes[] = {{"A2", 110.0f}, {"Ds6", 1244.51f}, {"C7", 2093.0f}};
+
+    std::printf("\nAliasing, dB below the harmonics\n%-30s", "");
+    for (const Note &n : notes)
+        std::printf(" %9s", n.name);
+    std::printf("\n");
+
+    auto row = [&](const char *name, auto make) {
+        std::printf("%-30s", name);
+        for (const Note &n : notes)
+            std::printf(" %9.1f", aliasDb(n.freq, make(n.freq)));
+        std::printf("\n");
+    };
+    row("naive saw", [](float f) {
+        NaiveOsc o;
+        o.freq(f);
+        return [o]() mutable { return o.saw(); };
+    });
+    row("band-limited saw (gam::Saw)", [](float f) {
+        BuzzSaw o;
+        o.freq(f);
+        return [o]() mutable { return o(); };
+    });
+    row("naive square", [](float f) {
+        NaiveOsc o;
+        o.freq(f);
+        return [o]() mutable { return o.sqr(); };
+    });
+    row("DPW square (gam::DWO::sqr)", [](float f) {
+        DpwOsc o;
+        o.freq(f);
+        return [o]() mutable { return o.sqr(); };
+    });
+    row("wavetable saw", [&](float f) {
+        WavetableOsc o;
+        o.freq(tables, f);
+        return [o]() mutable { return o.saw(); };
+    });
+    row("wavetable square", [&](float f) {
+        WavetableOsc o;
+        o.freq(tables, f);
+        return [o]() mutable { return o.square(); };
+    });
+    row("MiniSubBank saw", [&](float f) {
+        BankOsc o(tables, f, 0.0f);
+        return [o]() mutable { return o(); };
+    });
+    row("MiniSubBank square", [&](float f) {
+        BankOsc o(tables, f, 1.0f);
+        return [o]() mutable { return o(); };
+    });
+    return 0;
+}
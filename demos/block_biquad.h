@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cmath>
+
+#include "fastmath.h"
+
+// Resonant low pass biquad with block-rate coefficient updates.
+//
+// This is a drop-in for the gam::Biquad<> low pass used in MiniSubWaves.
+// gam::Biquad recomputes its coefficients (a cos, a sin and a divide) every
+// time freq() is called, and the voices call freq() once per sample to apply
+// the filter envelope. BlockBiquad only remembers the requested cutoff in
+// freq(), recomputes the coefficients every ctlRate() samples, and linearly
+// interpolates the coefficients in between so sweeps stay smooth.
+//
+// ctlRate(1) recomputes every sample, which is the same per-sample path
+// gam::Biquad takes.
+class BlockBiquad
+{
+private:
+    // coefficients currently in use, and their per-sample increments
+    float a0, a1, a2, b1, b2;
+    float da0, da1, da2, db1, db2;
+    // filter state (direct form II)
+    float d1, d2;
+
+    float mFreq;
+    float mRes;
+    float mSampleRate;
+    int mCtlRate;
+    int mCount;
+    bool mPrimed;
+
+    // RBJ cookbook low pass, same formulation as gam::Biquad LOW_PASS
+    void design(float freq, float &c0, float &c1, float &c2, float &e1, float &e2) const
+    {
+        float w = freq / mSampleRate;
+        if (w < 0.0f)
+            w = 0.0f;
+        if (w > 0.499f)
+            w = 0.499f;
+        // from the half angle, w / 2 cycles as a 32-bit phase: 1 - cos w =
+        // 2 sin^2(w / 2) keeps its precision at low cutoffs, where
+        // 1 - cos(w) in float loses it
+        const SineTable &sine = sineTable();
+        uint32_t half = (uint32_t)(int32_t)(w * 2147483648.0f);
+        float halfSin = sine(half);
+        float halfCos = sine(half + (1u << 30));
+        float oneMinusCos = 2.0f * halfSin * halfSin;
+        float alpha = halfSin * halfCos / mRes; // sin(w) / 2 / res
+        float norm = 1.0f / (1.0f + alpha);
+        c1 = oneMinusCos * norm;
+        c0 = c1 * 0.5f;
+        c2 = c0;
+        e1 = -2.0f * (1.0f - oneMinusCos) * norm;
+        e2 = (1.0f - alpha) * norm;
+    }
+
+    void update()
+    {
+        float c0, c1, c2, e1, e2;
+        design(mFreq, c0, c1, c2, e1, e2);
+        if (!mPrimed || mCtlRate == 1)
+        {
+            a0 = c0, a1 = c1, a2 = c2, b1 = e1, b2 = e2;
+            da0 = da1 = da2 = db1 = db2 = 0.0f;
+            mPrimed = true;
+        }
+        else
+        {
+            float scale = 1.0f / mCtlRate;
+            da0 = (c0 - a0) * scale;
+            da1 = (c1 - a1) * scale;
+            da2 = (c2 - a2) * scale;
+            db1 = (e1 - b1) * scale;
+            db2 = (e2 - b2) * scale;
+        }
+        mCount = mCtlRate;
+    }
+
+public:
+    BlockBiquad(int ctlRate = 32)
+    {
+        a0 = a1 = a2 = b1 = b2 = 0.0f;
+        da0 = da1 = da2 = db1 = db2 = 0.0f;
+        d1 = d2 = 0.0f;
+        mFreq = 1000.0f;
+        mRes = 1.0f;
+        mSampleRate = 44100.0f;
+        mCtlRate = ctlRate < 1 ? 1 : ctlRate;
+        mCount = 0;
+        mPrimed = false;
+    }
+
+    // Set cutoff frequency in Hz. Cheap: takes effect at the next update.
+    void freq(float v) { mFreq = v; }
+
+    // Set resonance. A new value forces a coefficient update on the next sample.
+    void res(float v)
+    {
+        v = v < 0.01f ? 0.01f : v;
+        if (v != mRes)
+        {
+            mRes = v;
+            mCount = 0;
+        }
+    }
+
+    // Number of samples between coefficient updates (1 = every sample)
+    void ctlRate(int samples)
+    {
+        mCtlRate = samples < 1 ? 1 : samples;
+        mCount = 0;
+    }
+    int ctlRate() const { return mCtlRate; }
+
+    void sampleRate(float v)
+    {
+        mSampleRate = v;
+        mCount = 0;
+    }
+
+    // Jump straight to the current cutoff and clear the filter history,
+    // e.g. when a voice is retriggered
+    void reset()
+    {
+        d1 = d2 = 0.0f;
+        mPrimed = false;
+        mCount = 0;
+    }
+
+    float operator()(float in)
+    {
+        if (--mCount <= 0)
+            update();
+        a0 += da0, a1 += da1, a2 += da2, b1 += db1, b2 += db2;
+
+        float w0 = in - d1 * b1 - d2 * b2;
+        float out = w0 * a0 + d1 * a1 + d2 * a2;
+        d2 = d1;
+        d1 = w0;
+        return out;
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+
+// White noise generated a block at a time, to stand in for gam::NoiseWhite.
+//
+// The generator is NOISE_LANES xorshift32 streams side by side; fill()
+// steps every lane at once and interleaves them, a loop of shifts, xors
+// and an int-to-float conversion the compiler vectorizes. operator() hands
+// out samples from a NOISE_CHUNK buffer it refills that way, so the render
+// loops keep their one-sample-at-a-time shape.
+//
+// A generator is seeded from a (seed, stream) pair, with each lane's state
+// hashed from both, so voices given different streams never share noise and
+// the same pair always produces the same samples.
+static const int NOISE_LANES = 8;
+static const int NOISE_CHUNK = 64;
+
+class BlockNoise
+{
+private:
+    static_assert(NOISE_CHUNK % NOISE_LANES == 0, "chunk must be a whole number of lanes");
+
+    alignas(32) uint32_t mState[NOISE_LANES];
+    alignas(32) float mChunk[NOISE_CHUNK];
+    int mNext = NOISE_CHUNK;
+
+    // splitmix32-style finalizer: spreads nearby inputs across the state space
+    static uint32_t hash(uint32_t x)
+    {
+        x += 0x9E3779B9u;
+        x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+        x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+        return x ^ (x >> 16);
+    }
+
+public:
+    BlockNoise() { seed(0, 0); }
+
+    // Restart on stream of seed
+    void seed(uint32_t seed, uint32_t stream)
+    {
+        for (int l = 0; l < NOISE_LANES; l++)
+        {
+            uint32_t s = hash(hash(seed) ^ (stream * NOISE_LANES + l));
+            mState[l] = s ? s : 1; // xorshift sticks at zero
+        }
+        mNext = NOISE_CHUNK;
+    }
+
+    // Write n samples in [-1, 1) to out; n a multiple of NOISE_LANES
+    void fill(float *out, int n)
+    {
+        uint32_t state[NOISE_LANES];
+        for (int l = 0; l < NOISE_LANES; l++)
+            state[l] = mState[l];
+        for (int i = 0; i < n; i += NOISE_LANES)
+            for (int l = 0; l < NOISE_LANES; l++)
+            {
+                uint32_t x = state[l];
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                state[l] = x;
+                out[i + l] = (float)(int32_t)x * (1.0f / 2147483648.0f);
+            }
+        for (int l = 0; l < NOISE_LANES; l++)
+            mState[l] = state[l];
+    }
+
+    float operator()()
+    {
+        if (mNext == NOISE_CHUNK)
+        {
+            fill(mChunk, NOISE_CHUNK);
+            mNext = 0;
+        }
+        return mChunk[mNext++];
+    }
+};
+
+// Hands out noise streams in order, from one seed. Reseeding with the same
+// seed and starting the same notes in the same order replays the same noise.
+class NoiseStreams
+{
+private:
+    uint32_t mSeed = 0;
+    uint32_t mNext = 0;
+
+public:
+    void seed(uint32_t seed)
+    {
+        mSeed = seed;
+        mNext = 0;
+    }
+
+    // Seed noise with the next stream
+    void next(BlockNoise &noise) { noise.seed(mSeed, mNext++); }
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+
+// Sample-accurate event scheduler for the audio thread.
+//
+// Events are filed under the absolute audio frame they are due on and kept
+// in a preallocated binary heap, so scheduling never allocates. Each block
+// the audio callback pops the events due before the end of the block with
+// next() and applies each at its exact offset into the block (a voice start
+// offset, or the frame a voice splits its render at to release), instead of
+// rounding it to a block boundary. Events due on the same frame come out in
+// the order they were scheduled.
+template <class Event, int CAPACITY>
+class EventScheduler
+{
+private:
+    struct Item
+    {
+        uint64_t frame;
+        uint32_t order; // tie-break: first scheduled, first out
+        Event event;
+    };
+
+    Item mHeap[CAPACITY];
+    int mSize = 0;
+    uint32_t mOrder = 0;
+
+    static bool before(const Item &a, const Item &b)
+    {
+        return a.frame != b.frame ? a.frame < b.frame : (int32_t)(a.order - b.order) < 0;
+    }
+
+public:
+    // File e under frame. Returns false (and drops it) if the heap is full.
+    bool schedule(uint64_t frame, const Event &e)
+    {
+        if (mSize == CAPACITY)
+            return false;
+        int i = mSize++;
+        Item item = {frame, mOrder++, e};
+        while (i > 0 && before(item, mHeap[(i - 1) / 2]))
+        {
+            mHeap[i] = mHeap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        mHeap[i] = item;
+        return true;
+    }
+
+    // Take the earliest event due before endFrame
+    bool next(uint64_t endFrame, uint64_t &frame, Event &e)
+    {
+        if (mSize == 0 || mHeap[0].frame >= endFrame)
+            return false;
+        frame = mHeap[0].frame;
+        e = mHeap[0].event;
+
+        Item last = mHeap[--mSize];
+        int i = 0;
+        for (;;)
+        {
+            int child = 2 * i + 1;
+            if (child >= mSize)
+                break;
+            if (child + 1 < mSize && before(mHeap[child + 1], mHeap[child]))
+                child++;
+            if (!before(mHeap[child], last))
+                break;
+            mHeap[i] = mHeap[child];
+            i = child;
+        }
+        mHeap[i] = last;
+        return true;
+    }
+
+    int size() const { return mSize; }
+    static int capacity() { return CAPACITY; }
+    void clear() { mSize = 0; }
+};
+
+// Offset into the block starting at blockStart of an event due on frame.
+// An event that is already late plays at the first frame of the block.
+inline int blockOffset(uint64_t frame, uint64_t blockStart)
+{
+    return frame > blockStart ? (int)(frame - blockStart) : 0;
+}
+
+// A voice's release, split into its render loop at the frame of the block
+// it is due on. releaseAt() files the offset for the next block rendered;
+// the render function calls beginBlock() before its sample loop and
+// releases the note on the first frame due() returns true for.
+class ReleaseSplit
+{
+private:
+    int mPending = -1; // offset filed for the next block
+    int mFrame = -1;   // offset in the block being rendered
+
+public:
+    void at(int offset) { mPending = offset; }
+
+    // Forget any pending release, e.g. when the voice is retriggered
+    void clear() { mPending = mFrame = -1; }
+
+    void beginBlock()
+    {
+        mFrame = mPending;
+        mPending = -1;
+    }
+
+    // True once, on the first frame at or after the release offset
+    bool due(int frame)
+    {
+        if (mFrame < 0 || frame < mFrame)
+            return false;
+        mFrame = -1;
+        return true;
+    }
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// How the delay line is read between samples
+enum CombInterp
+{
+    COMB_LINEAR,   // same as gam::Comb; damps the highs of short delays
+    COMB_ALLPASS,  // first-order allpass: flat magnitude, but goes out of tune near the top of the keyboard
+    COMB_LAGRANGE, // third-order Lagrange: best tuning, within 0.05 cents up to C8 at 48 kHz
+};
+
+// Comb filter on a fixed-capacity delay line.
+//
+// Same behaviour as gam::Comb<> (feedforward and feedback amounts, decay() in
+// seconds), but the buffer is allocated once by capacity() and never
+// resized. gam::Comb::maxDelay() may reallocate, which must not happen on the
+// audio thread; with FixedComb changing the delay only moves the read
+// position.
+//
+// For Karplus-Strong the delay sets the pitch, so it can also be read with
+// fractional-delay interpolation (see CombInterp) for accurate tuning, and
+// the feedback can pass through a one-pole lowpass (damping()) that dulls
+// each trip round the loop like a real string. The lowpass's own delay at
+// the loop's fundamental is taken off the delay line, so the loop still
+// sounds at sampleRate / delaySamples().
+class FixedComb
+{
+private:
+    std::vector<float> mBuf;
+    unsigned mMask;
+    unsigned mWrite;
+
+    CombInterp mInterp;
+    unsigned mApInt; // allpass integer delay
+    float mApCoef;   // allpass coefficient for the fractional part
+    float mApPrev; // allpass input/output history
+    float mApOut;
+
+    float mSampleRate;
+    float mDelay;     // seconds
+    float mDelaySamp; // samples, clamped to the capacity
+    unsigned mDelayInt; // integer and fractional parts of mDelaySamp, kept
+    float mDelayFrac;   // apart so the read position never loses precision
+    float mLagrange[4]; // tap weights for mDelayFrac, see read()
+    float mDamp;    // loop lowpass pole, 0 for none
+    float mDampOut; // loop lowpass state
+    float mFfd;
+    float mFbk;
+
+    static unsigned nextPow2(unsigned v)
+    {
+        unsigned n = 1;
+        while (n < v)
+            n <<= 1;
+        return n;
+    }
+
+    // sample written n samples ago (n >= 1)
+    float tap(unsigned n) const { return mBuf[(mWrite - n) & mMask]; }
+
+    // Place the read point for mDelaySamp and mDamp
+    void retune()
+    {
+        // the loop lowpass delays the fundamental by
+        // atan(d sin w / (1 - d cos w)) / w samples; read that much sooner
+        float samp = mDelaySamp;
+        if (mDamp > 0.0f)
+        {
+            float w = 2.0f * (float)M_PI / samp;
+            samp -= std::atan2(mDamp * std::sin(w), 1.0f - mDamp * std::cos(w)) / w;
+            if (samp < 2.0f)
+                samp = 2.0f;
+        }
+
+        mDelayInt = (unsigned)samp;
+        mDelayFrac = samp - (float)mDelayInt;
+
+        float f = 1.0f - mDelayFrac;
+        float fm1 = f - 1.0f, fm2 = f - 2.0f, fp1 = f + 1.0f;
+        mLagrange[0] = -f * fm1 * fm2 * (1.0f / 6.0f);
+        mLagrange[1] = fp1 * fm1 * fm2 * 0.5f;
+        mLagrange[2] = -fp1 * f * fm2 * 0.5f;
+        mLagrange[3] = fp1 * f * fm1 * (1.0f / 6.0f);
+
+        // integer part plus a fractional part in [0.5, 1.5) keeps the
+        // allpass coefficient in (-0.2, 0.33] where its delay is accurate
+        mApInt = (unsigned)(samp - 0.5f);
+        float frac = samp - (float)mApInt;
+        mApCoef = (1.0f - frac) / (1.0f + frac);
+    }
+
+    float read()
+    {
+        switch (mInterp)
+        {
+        case COMB_ALLPASS:
+        {
+            float in = tap(mApInt);
+            mApOut = mApCoef * (in - mApOut) + mApPrev;
+            mApPrev = in;
+            return mApOut;
+        }
+        case COMB_LAGRANGE:
+        {
+            // taps at delays n-1 .. n+2 around the read point
+            return tap(mDelayInt + 2) * mLagrange[0] + tap(mDelayInt + 1) * mLagrange[1] +
+                   tap(mDelayInt) * mLagrange[2] + tap(mDelayInt - 1) * mLagrange[3];
+        }
+        default:
+        {
+            float x0 = tap(mDelayInt);
+            float x1 = tap(mDelayInt + 1);
+            return x0 + (x1 - x0) * mDelayFrac;
+        }
+        }
+    }
+
+public:
+    FixedComb()
+    {
+        mMask = 0;
+        mWrite = 0;
+        mInterp = COMB_LINEAR;
+        mApInt = 1;
+        mApCoef = 0.0f;
+        mApPrev = 0.0f;
+        mApOut = 0.0f;
+        mSampleRate = 44100.0f;
+        mDelay = 0.0f;
+        mDelaySamp = 2.0f;
+        mDelayInt = 2;
+        mDelayFrac = 0.0f;
+        mLagrange[0] = mLagrange[1] = mLagrange[3] = 0.0f;
+        mLagrange[2] = 1.0f;
+        mDamp = 0.0f;
+        mDampOut = 0.0f;
+        mFfd = 0.0f;
+        mFbk = 0.0f;
+    }
+
+    // Allocate room for delays up to maxDelay seconds at up to maxSampleRate.
+    // Call once from init(), never from the audio thread.
+    void capacity(float maxDelay, float maxSampleRate)
+    {
+        mBuf.assign(nextPow2((unsigned)std::ceil(maxDelay * maxSampleRate) + 4), 0.0f);
+        mMask = (unsigned)mBuf.size() - 1;
+        mWrite = 0;
+    }
+
+    // Longest delay that fits at the current sample rate, in seconds
+    float maxDelay() const { return (mBuf.size() - 4) / mSampleRate; }
+
+    void sampleRate(float v)
+    {
+        mSampleRate = v;
+        delay(mDelay);
+    }
+
+    void ipolType(CombInterp v) { mInterp = v; }
+    CombInterp ipolType() const { return mInterp; }
+
+    // Set delay in seconds. Never allocates; clamped to the capacity.
+    void delay(float seconds) { delaySamples(seconds * mSampleRate); }
+    float delay() const { return mDelay; }
+
+    // Set delay in samples. Karplus-Strong voices should compute this as
+    // sampleRate / noteFreq once per note or block, not once per sample;
+    // setting the delay it already has costs nothing.
+    void delaySamples(float samp)
+    {
+        float maxSamp = (float)mBuf.size() - 4.0f;
+        if (samp > maxSamp)
+            samp = maxSamp;
+        if (samp < 2.0f)
+            samp = 2.0f;
+        mDelay = samp / mSampleRate;
+        if (samp == mDelaySamp)
+            return;
+        mDelaySamp = samp;
+        retune();
+    }
+    float delaySamples() const { return mDelaySamp; }
+
+    // Lowpass the feedback with pole amount in [0, 1): 0 is no filtering,
+    // higher values darken the loop faster. Retunes the current delay if
+    // the amount changed.
+    void damping(float amount)
+    {
+        amount = amount < 0.0f ? 0.0f : (amount > 0.99f ? 0.99f : amount);
+        if (amount == mDamp)
+            return;
+        mDamp = amount;
+        retune();
+    }
+    float damping() const { return mDamp; }
+
+    void ffd(float v) { mFfd = v; }
+    void fbk(float v) { mFbk = v; }
+
+    // Set feedback so the loop decays to end (-60 dB by default) after
+    // units seconds at the current delay, like gam::Comb::decay(). Set the
+    // delay first; changing it later doesn't recompute the feedback.
+    void decay(float units, float end = 0.001f)
+    {
+        if (units == 0.0f)
+            mFbk = 0.0f;
+        else
+            mFbk = std::pow(end, mDelay / std::fabs(units)) * (units < 0.0f ? -1.0f : 1.0f);
+    }
+
+    // Clear the delay line, e.g. when a voice is retriggered
+    void reset()
+    {
+        for (float &s : mBuf)
+            s = 0.0f;
+        mApPrev = mApOut = 0.0f;
+        mDampOut = 0.0f;
+    }
+
+    float operator()(float in)
+    {
+        float delayed = read();
+        float loop = delayed;
+        if (mDamp > 0.0f)
+            loop = mDampOut = delayed * (1.0f - mDamp) + mDampOut * mDamp; // one multiply-add on the recursion
+        float w = in + loop * mFbk;
+        mBuf[mWrite & mMask] = w;
+        mWrite++;
+        return delayed + w * mFfd;
+    }
+};
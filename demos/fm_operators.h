@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "fastmath.h"
+
+// Phase modulation operators, as in DX-style FM synths.
+//
+// Each operator is a 32-bit phase accumulator reading the shared sine table
+// from fastmath.h. A modulator's output is added to the phase of the
+// operators it modulates, so a note's frequencies are turned into phase
+// increments once, instead of a carrier frequency being recomputed from the
+// modulator every sample.
+// Modulating phase with I sin(wm t) gives the same spectrum as modulating
+// frequency with I wm cos(wm t): a modulator's level is its modulation index
+// in radians.
+//
+// An FMAlgorithm wires 2 to FM_MAX_OPERATORS operators together.
+// FMOperators renders FM_BLOCK samples at a time, one operator after
+// another, so the inner loops are fixed-length runs over arrays. Operator
+// levels are set once per block and ramped linearly across it.
+static const int FM_MAX_OPERATORS = 6;
+static const int FM_BLOCK = 32;
+static const float FM_MAX_FEEDBACK = 3.14f; // radians, just under pi
+
+// How operators modulate each other. Operator i may only be modulated by
+// operators with a higher index, which are computed first.
+struct FMAlgorithm
+{
+    int operators;                         // 2 to FM_MAX_OPERATORS
+    uint8_t modulators[FM_MAX_OPERATORS];  // bit j: operator j modulates operator i
+    uint8_t carriers;                      // bit i: operator i is heard
+    int feedback;                          // operator modulating itself, -1 for none
+};
+
+// 1 -> 0: the classic two-sine FM voice
+static const FMAlgorithm FM_PAIR = {2, {0x02, 0, 0, 0, 0, 0}, 0x01, -1};
+// 2 -> 1 -> 0
+static const FMAlgorithm FM_STACK3 = {3, {0x02, 0x04, 0, 0, 0, 0}, 0x01, -1};
+// 3 -> 2 -> 1 -> 0, 3 fed back
+static const FMAlgorithm FM_STACK4 = {4, {0x02, 0x04, 0x08, 0, 0, 0}, 0x01, 3};
+// 1 -> 0 and 3 -> 2, mixed
+static const FMAlgorithm FM_TWO_PAIRS = {4, {0x02, 0, 0x08, 0, 0, 0}, 0x05, -1};
+// 1 -> 0 and 5 -> 4 -> 3 -> 2, 5 fed back (DX7 algorithm 1)
+static const FMAlgorithm FM_DX_BRASS = {6, {0x02, 0, 0x08, 0x10, 0x20, 0}, 0x05, 5};
+// 1 -> 0, 3 -> 2 and 5 -> 4, mixed, 5 fed back (DX7 algorithm 5)
+static const FMAlgorithm FM_THREE_PAIRS = {6, {0x02, 0, 0x08, 0, 0x20, 0}, 0x15, 5};
+
+class FMOperators
+{
+private:
+    const SineTable *mSine = &sineTable();
+    float mSampleRate = 48000.0f;
+
+    int mCount = 0;
+    int mFeedbackOp = -1;
+    uint8_t mCarriers = 0;
+    int mNumMods[FM_MAX_OPERATORS];
+    int mMods[FM_MAX_OPERATORS][FM_MAX_OPERATORS]; // modulator indices of each operator
+
+    uint32_t mPhase[FM_MAX_OPERATORS];
+    uint32_t mInc[FM_MAX_OPERATORS];
+    float mLevel[FM_MAX_OPERATORS];  // at the end of the last block
+    float mTarget[FM_MAX_OPERATORS]; // at the end of the next block
+    float mFeedback = 0.0f;
+    float mFeedbackLast[2] = {0.0f, 0.0f}; // the feedback operator's last two sines
+    float mOut[FM_MAX_OPERATORS][FM_BLOCK]; // each operator's last block
+
+    // 2^32 / 2 pi: radians to phase accumulator units
+    static constexpr float RADIANS_TO_PHASE = 683565275.6f;
+
+public:
+    FMOperators() : FMOperators(FM_PAIR) {}
+
+    explicit FMOperators(const FMAlgorithm &algo)
+    {
+        for (int i = 0; i < FM_MAX_OPERATORS; i++)
+        {
+            mInc[i] = 0;
+            mTarget[i] = 0.0f;
+        }
+        algorithm(algo);
+        reset();
+    }
+
+    // Rewire the operators; modulators that don't have a higher index than
+    // their operator, or that are past algo.operators, are ignored
+    void algorithm(const FMAlgorithm &algo)
+    {
+        mCount = algo.operators < 1 ? 1 : algo.operators > FM_MAX_OPERATORS ? FM_MAX_OPERATORS : algo.operators;
+        mCarriers = algo.carriers;
+        mFeedbackOp = algo.feedback < mCount ? algo.feedback : -1;
+        for (int i = 0; i < mCount; i++)
+        {
+            mNumMods[i] = 0;
+            for (int j = i + 1; j < mCount; j++)
+                if (algo.modulators[i] & (1 << j))
+                    mMods[i][mNumMods[i]++] = j;
+        }
+    }
+
+    void sampleRate(float sampleRate) { mSampleRate = sampleRate; }
+
+    // Restart every operator at phase 0 and at its level() target
+    void reset()
+    {
+        for (int i = 0; i < FM_MAX_OPERATORS; i++)
+        {
+            mPhase[i] = 0;
+            mLevel[i] = mTarget[i];
+        }
+        mFeedbackLast[0] = mFeedbackLast[1] = 0.0f;
+    }
+
+    // Frequency of operator op in Hz
+    void freq(int op, float hz) { mInc[op] = (uint32_t)(int64_t)std::llround((double)hz / mSampleRate * 4294967296.0); }
+
+    // Level of operator op: modulation index in radians for a modulator,
+    // amplitude for a carrier. The next render() ramps to it.
+    void level(int op, float level) { mTarget[op] = level; }
+
+    // Self-modulation of the algorithm's feedback operator, in radians of
+    // its own unscaled output, 0 to FM_MAX_FEEDBACK
+    void feedback(float amount) { mFeedback = amount < 0.0f ? 0.0f : amount > FM_MAX_FEEDBACK ? FM_MAX_FEEDBACK : amount; }
+
+    // Write the next FM_BLOCK samples of the carriers' sum to out.
+    // Operators are rendered a whole block at a time, modulators first.
+    void render(float *out)
+    {
+        const SineTable &sine = *mSine;
+        for (int k = 0; k < FM_BLOCK; k++)
+            out[k] = 0.0f;
+        for (int i = mCount - 1; i >= 0; i--)
+        {
+            float *buf = mOut[i];
+            float level = mLevel[i];
+            float step = (mTarget[i] - level) * (1.0f / FM_BLOCK);
+            uint32_t phase = mPhase[i];
+            uint32_t inc = mInc[i];
+
+            float mod[FM_BLOCK];
+            for (int k = 0; k < FM_BLOCK; k++)
+                mod[k] = 0.0f;
+            for (int m = 0; m < mNumMods[i]; m++)
+            {
+                const float *in = mOut[mMods[i][m]];
+                for (int k = 0; k < FM_BLOCK; k++)
+                    mod[k] += in[k];
+            }
+
+            // the phase arithmetic vectorizes; only the table reads are scalar
+            uint32_t phases[FM_BLOCK];
+            for (int k = 0; k < FM_BLOCK; k++)
+            {
+                phases[k] = phase + radiansToPhase(mod[k]);
+                phase += inc;
+            }
+
+            if (i == mFeedbackOp)
+            {
+                // each sample depends on the last two, so this one runs
+                // serially; averaging them keeps high feedback from buzzing.
+                // |a + b| <= 2, so the offset fits in an int32 unwrapped.
+                float scale = mFeedback * 0.5f * RADIANS_TO_PHASE;
+                float a = mFeedbackLast[0], b = mFeedbackLast[1];
+                for (int k = 0; k < FM_BLOCK; k++)
+                {
+                    float s = sine(phases[k] + (uint32_t)(int32_t)((a + b) * scale));
+                    b = a;
+                    a = s;
+                    buf[k] = s * (level + step * (float)(k + 1));
+                }
+                mFeedbackLast[0] = a;
+                mFeedbackLast[1] = b;
+            }
+            else
+            {
+                for (int k = 0; k < FM_BLOCK; k++)
+                    buf[k] = sine(phases[k]) * (level + step * (float)(k + 1));
+            }
+
+            mLevel[i] = mTarget[i];
+            mPhase[i] = phase;
+            if (mCarriers & (1 << i))
+                for (int k = 0; k < FM_BLOCK; k++)
+                    out[k] += buf[k];
+        }
+    }
+};
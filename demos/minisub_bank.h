@@ -0,0 +1,573 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "fastmath.h"
+#include "wavetable.h"
+
+// Vectorized voice bank for MiniSubWaves.
+//
+// Each MiniSubWaves voice normally runs its own saw, square, noise, biquad
+// and two ADSRs one sample at a time. The bank instead keeps the state of up
+// to LANES voices as structure-of-arrays, in groups of W lanes (4, 8 or 16),
+// and renders a whole group in lockstep: the inner loops run across the W
+// lanes of a group with no branches, so the compiler turns them into
+// SSE/AVX/NEON vector code (build with -O3, and -march=native for AVX).
+//
+// Voices stay ordinary SynthVoices, started and rendered by a VoicePlayer
+// (see voice_pool.h) or PolySynth: onTriggerOn takes a lane and hands it the
+// voice's parameters, onTriggerOff releases it, and onProcess only tells the
+// bank where in the block the note starts and frees the voice once its lane
+// is done. The app then calls render() once per block after the voices have
+// rendered to mix every lane into the output.
+//
+// Oscillators read the same band-limited WavetableBank as WavetableOsc, so a
+// note sounds the same in the bank as rendered by its own voice: each lane
+// keeps a phase, its increment and where its note's tables start, as an
+// offset from the bank's data() so the lanes' reads can be one vector
+// gather. Envelopes are attack/decay/sustain/release with
+// gamma-style curvature. The filter is the same low pass as BlockBiquad,
+// retuned at the start of each sub-block of at most ctlRate samples.
+template <int W, int LANES = 64, int MAX_FRAMES = 1024>
+class MiniSubBank
+{
+    static_assert(LANES % W == 0, "LANES must be a multiple of W");
+
+public:
+    static const int NUM_GROUPS = LANES / W;
+
+private:
+    enum Stage
+    {
+        ENV_WAIT, // note triggered, waiting for its offset within the block
+        ENV_ATTACK,
+        ENV_DECAY,
+        ENV_SUSTAIN,
+        ENV_RELEASE,
+        ENV_DONE
+    };
+
+    static const int HOLD = 1 << 30; // samples left in a segment that never ends
+    static const int OSC_FRAC_BITS = 32 - WAVETABLE_SIZE_BITS; // phase bits below the table index
+
+    // Envelope segments follow value = a + b * m, with m = m * mul + add each
+    // sample. That covers both linear (mul 1, add 1) and curved
+    // (mul = exp(curve / length), add 0) segments with the same vector code.
+    struct EnvLanes
+    {
+        alignas(64) float a[W], b[W], m[W], mul[W], add[W];
+        alignas(64) float value[W];
+        int left[W];
+        int stage[W];
+        // ADSR settings
+        float atk[W], dec[W], sus[W], rel[W], curve[W];
+    };
+
+    struct Group
+    {
+        // oscillators: phase and increment (2^32 is one cycle), and the
+        // offset of the saw table in mTables (the square is SHAPE_STRIDE on).
+        // inc is 0 until the note starts, so every note starts at phase 0
+        // wherever it falls in the block.
+        alignas(64) uint32_t phase[W], inc[W];
+        alignas(64) int32_t table[W];
+        uint32_t noteInc[W];
+        alignas(64) uint32_t rng[W];
+        // mix weights: saw, square, noise
+        alignas(64) float wSaw[W], wSqr[W], wNoise[W];
+        // filter coefficients, their per-sample increments, and state
+        alignas(64) float a0[W], a1[W], a2[W], b1[W], b2[W];
+        alignas(64) float da0[W], da1[W], da2[W], db1[W], db2[W];
+        alignas(64) float d1[W], d2[W];
+        float filtFreq[W], filtDepth[W], filtRes[W];
+        // output gain and pan
+        alignas(64) float amp[W];
+        float panL[W], panR[W];
+
+        EnvLanes ampEnv;
+        EnvLanes filtEnv;
+
+        bool used[W];
+        bool fresh[W]; // note just started: jump straight to its filter setting
+        int releaseIn[W]; // samples until a scheduled noteOffAt(), HOLD if none
+        int numReleases;  // lanes with a noteOffAt() pending
+        int numUsed;
+
+        // output of each lane for the current block, frame-major
+        alignas(64) float out[MAX_FRAMES][W];
+    };
+
+    Group mGroups[NUM_GROUPS];
+    const float *mTables; // WavetableBank::data() of the last noteOn()
+    float mSampleRate;
+    int mCtlRate;
+
+    // --- envelopes (scalar, once per segment) ---
+
+    void holdSegment(EnvLanes &e, int l, float v, int len)
+    {
+        e.value[l] = v;
+        e.a[l] = v;
+        e.b[l] = 0.0f;
+        e.m[l] = 0.0f;
+        e.mul[l] = 1.0f;
+        e.add[l] = 0.0f;
+        e.left[l] = len;
+    }
+
+    void rampSegment(EnvLanes &e, int l, float target, float seconds)
+    {
+        float start = e.value[l];
+        int len = (int)(seconds * mSampleRate + 0.5f);
+        if (len < 1)
+            len = 1;
+        float c = e.curve[l];
+        if (std::fabs(c) < 0.001f)
+        {
+            e.a[l] = start;
+            e.b[l] = (target - start) / len;
+            e.m[l] = 0.0f;
+            e.mul[l] = 1.0f;
+            e.add[l] = 1.0f;
+        }
+        else
+        {
+            float norm = (target - start) / (1.0f - std::exp(c));
+            e.a[l] = start + norm;
+            e.b[l] = -norm;
+            e.m[l] = 1.0f;
+            e.mul[l] = std::exp(c / len);
+            e.add[l] = 0.0f;
+        }
+        e.left[l] = len;
+    }
+
+    // Move to the next envelope stage once the current segment has run out
+    void advance(EnvLanes &e, int l)
+    {
+        while (e.left[l] <= 0)
+        {
+            switch (e.stage[l])
+            {
+            case ENV_WAIT:
+                e.stage[l] = ENV_ATTACK;
+                rampSegment(e, l, 1.0f, e.atk[l]);
+                break;
+            case ENV_ATTACK:
+                e.stage[l] = ENV_DECAY;
+                rampSegment(e, l, e.sus[l], e.dec[l]);
+                break;
+            case ENV_DECAY:
+                e.stage[l] = ENV_SUSTAIN;
+                holdSegment(e, l, e.sus[l], HOLD);
+                break;
+            default: // release finished
+                e.stage[l] = ENV_DONE;
+                holdSegment(e, l, 0.0f, HOLD);
+                break;
+            }
+        }
+    }
+
+    void release(EnvLanes &e, int l)
+    {
+        if (e.stage[l] == ENV_WAIT || e.stage[l] == ENV_DONE)
+        {
+            e.stage[l] = ENV_DONE;
+            holdSegment(e, l, 0.0f, HOLD);
+            return;
+        }
+        e.stage[l] = ENV_RELEASE;
+        rampSegment(e, l, 0.0f, e.rel[l]);
+    }
+
+    // --- filter (scalar, once per sub-block) ---
+
+    // Set the filter to reach the coefficients for the current envelope
+    // value over the next n samples (immediately if jump)
+    void retune(Group &g, int l, int n, bool jump)
+    {
+        float freq = g.filtFreq[l] + g.filtEnv.value[l] * g.filtDepth[l];
+        float w = freq / mSampleRate;
+        w = w < 0.0f ? 0.0f : (w > 0.499f ? 0.499f : w);
+        // from the half angle, as in BlockBiquad::design()
+        const SineTable &sine = sineTable();
+        uint32_t half = (uint32_t)(int32_t)(w * 2147483648.0f);
+        float halfSin = sine(half);
+        float halfCos = sine(half + (1u << 30));
+        float oneMinusCos = 2.0f * halfSin * halfSin;
+        float alpha = halfSin * halfCos / g.filtRes[l];
+        float norm = 1.0f / (1.0f + alpha);
+        float c1 = oneMinusCos * norm;
+        float c0 = c1 * 0.5f;
+        float e1 = -2.0f * (1.0f - oneMinusCos) * norm;
+        float e2 = (1.0f - alpha) * norm;
+        if (jump)
+        {
+            g.a0[l] = c0, g.a1[l] = c1, g.a2[l] = c0, g.b1[l] = e1, g.b2[l] = e2;
+            g.da0[l] = g.da1[l] = g.da2[l] = g.db1[l] = g.db2[l] = 0.0f;
+            return;
+        }
+        float scale = 1.0f / n;
+        g.da0[l] = (c0 - g.a0[l]) * scale;
+        g.da1[l] = (c1 - g.a1[l]) * scale;
+        g.da2[l] = (c0 - g.a2[l]) * scale;
+        g.db1[l] = (e1 - g.b1[l]) * scale;
+        g.db2[l] = (e2 - g.b2[l]) * scale;
+    }
+
+    // --- the vector loop ---
+
+    static void stepEnv(EnvLanes &e, float *out)
+    {
+        for (int l = 0; l < W; l++)
+        {
+            e.m[l] = e.m[l] * e.mul[l] + e.add[l];
+            out[l] = e.a[l] + e.b[l] * e.m[l];
+        }
+    }
+
+    // Render n samples of every lane in the group, starting at frame
+    static void renderLanes(Group &g, const float *tables, int frame, int n)
+    {
+        alignas(64) float ampEnv[W], filtEnv[W];
+        for (int l = 0; l < W; l++)
+        {
+            ampEnv[l] = g.ampEnv.value[l];
+            filtEnv[l] = g.filtEnv.value[l];
+        }
+        for (int i = 0; i < n; i++)
+        {
+            stepEnv(g.ampEnv, ampEnv);
+            stepEnv(g.filtEnv, filtEnv);
+            float *out = g.out[frame + i];
+
+            // saw and square from the tables, as WavetableOsc::mix(); a
+            // loop of its own so the reads become gathers
+            alignas(64) float saw[W], square[W];
+            for (int l = 0; l < W; l++)
+            {
+                uint32_t ph = g.phase[l];
+                g.phase[l] = ph + g.inc[l];
+                int32_t i = g.table[l] + (int32_t)(ph >> OSC_FRAC_BITS);
+                float frac = (float)(int32_t)(ph & ((1u << OSC_FRAC_BITS) - 1)) * (1.0f / (1u << OSC_FRAC_BITS));
+                saw[l] = tables[i] + frac * (tables[i + 1] - tables[i]);
+                i += WavetableBank::SHAPE_STRIDE;
+                square[l] = tables[i] + frac * (tables[i + 1] - tables[i]);
+            }
+
+            for (int l = 0; l < W; l++)
+            {
+                // xorshift white noise
+                uint32_t x = g.rng[l];
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                g.rng[l] = x;
+                float noise = (float)(int32_t)x * (1.0f / 2147483648.0f);
+
+                float s = saw[l] * g.wSaw[l] + square[l] * g.wSqr[l] + noise * g.wNoise[l];
+
+                // low pass, coefficients interpolated across the sub-block
+                g.a0[l] += g.da0[l];
+                g.a1[l] += g.da1[l];
+                g.a2[l] += g.da2[l];
+                g.b1[l] += g.db1[l];
+                g.b2[l] += g.db2[l];
+                float w = s - g.d1[l] * g.b1[l] - g.d2[l] * g.b2[l];
+                float y = w * g.a0[l] + g.d1[l] * g.a1[l] + g.d2[l] * g.a2[l];
+                g.d2[l] = g.d1[l];
+                g.d1[l] = w;
+
+                out[l] = y * ampEnv[l] * g.amp[l];
+            }
+        }
+        for (int l = 0; l < W; l++)
+        {
+            g.ampEnv.value[l] = ampEnv[l];
+            g.filtEnv.value[l] = filtEnv[l];
+        }
+    }
+
+    // Forget a pending noteOffAt()
+    static void cancelRelease(Group &g, int l)
+    {
+        if (g.releaseIn[l] != HOLD)
+            g.numReleases--;
+        g.releaseIn[l] = HOLD;
+    }
+
+    // Release lanes whose noteOffAt() frame has come, and shorten the
+    // sub-block of n samples to end at the next one
+    int scheduledReleases(Group &g, int n)
+    {
+        for (int l = 0; l < W; l++)
+        {
+            if (g.releaseIn[l] <= 0)
+            {
+                release(g.ampEnv, l);
+                release(g.filtEnv, l);
+                g.releaseIn[l] = HOLD;
+                g.numReleases--;
+            }
+            if (g.releaseIn[l] < n)
+                n = g.releaseIn[l];
+        }
+        return n;
+    }
+
+    void renderGroup(Group &g, int frames)
+    {
+        int frame = 0;
+        while (frame < frames)
+        {
+            // sub-block: up to the next control update or envelope segment end
+            int n = frames - frame;
+            if (n > mCtlRate)
+                n = mCtlRate;
+            if (g.numReleases)
+                n = scheduledReleases(g, n);
+            for (int l = 0; l < W; l++)
+            {
+                advance(g.ampEnv, l);
+                advance(g.filtEnv, l);
+                if (g.ampEnv.stage[l] != ENV_WAIT)
+                    g.inc[l] = g.noteInc[l];
+                if (g.ampEnv.left[l] < n)
+                    n = g.ampEnv.left[l];
+                if (g.filtEnv.left[l] < n)
+                    n = g.filtEnv.left[l];
+            }
+            for (int l = 0; l < W; l++)
+            {
+                if (g.used[l])
+                    retune(g, l, n, g.fresh[l]);
+                g.fresh[l] = false;
+            }
+
+            renderLanes(g, mTables, frame, n);
+
+            for (int l = 0; l < W; l++)
+            {
+                g.ampEnv.left[l] -= n;
+                g.filtEnv.left[l] -= n;
+            }
+            if (g.numReleases)
+                for (int l = 0; l < W; l++)
+                    g.releaseIn[l] -= g.releaseIn[l] == HOLD ? 0 : n;
+            frame += n;
+        }
+    }
+
+    // Render at most MAX_FRAMES frames of every active lane into the output
+    void renderChunk(float *left, float *right, int frames)
+    {
+        if (!mTables)
+            return; // no note yet, so nothing to hear
+        for (Group &g : mGroups)
+        {
+            if (g.numUsed == 0)
+                continue;
+            renderGroup(g, frames);
+            for (int l = 0; l < W; l++)
+            {
+                if (!g.used[l])
+                    continue;
+                float gl = g.panL[l], gr = g.panR[l];
+                for (int i = 0; i < frames; i++)
+                {
+                    left[i] += g.out[i][l] * gl;
+                    right[i] += g.out[i][l] * gr;
+                }
+            }
+        }
+    }
+
+    Group &group(int lane) { return mGroups[lane / W]; }
+
+public:
+    MiniSubBank()
+    {
+        std::memset(mGroups, 0, sizeof(mGroups));
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            Group &g = group(lane);
+            int l = lane % W;
+            g.ampEnv.stage[l] = g.filtEnv.stage[l] = ENV_DONE;
+            holdSegment(g.ampEnv, l, 0.0f, HOLD);
+            holdSegment(g.filtEnv, l, 0.0f, HOLD);
+            g.filtRes[l] = 1.0f;
+            g.releaseIn[l] = HOLD;
+            g.rng[l] = 0x9E3779B9u * (lane + 1);
+        }
+        mTables = nullptr;
+        mSampleRate = 44100.0f;
+        mCtlRate = 32;
+    }
+
+    // Samples between filter coefficient updates
+    void ctlRate(int samples) { mCtlRate = samples < 1 ? 1 : samples; }
+
+    // Claim a free lane, or -1 if the bank is full
+    int acquire()
+    {
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            Group &g = group(lane);
+            int l = lane % W;
+            if (!g.used[l])
+            {
+                g.used[l] = true;
+                g.numUsed++;
+                return lane;
+            }
+        }
+        return -1;
+    }
+
+    // Give a lane back once its voice is freed
+    void release(int lane)
+    {
+        Group &g = group(lane);
+        int l = lane % W;
+        if (!g.used[l])
+            return;
+        g.used[l] = false;
+        g.numUsed--;
+        g.amp[l] = 0.0f;
+        cancelRelease(g, l);
+        g.ampEnv.stage[l] = g.filtEnv.stage[l] = ENV_DONE;
+        holdSegment(g.ampEnv, l, 0.0f, HOLD);
+        holdSegment(g.filtEnv, l, 0.0f, HOLD);
+    }
+
+    // Start a note on a lane from a MiniSubWavesParams-style block, playing
+    // from tables, which must be built (at the output sample rate) and must
+    // outlive the note. The note waits until startAt() says where in the
+    // block it begins.
+    template <class Params>
+    void noteOn(int lane, const Params &p, const WavetableBank &tables)
+    {
+        float sampleRate = tables.sampleRate();
+        mSampleRate = sampleRate;
+        mTables = tables.data();
+        Group &g = group(lane);
+        int l = lane % W;
+
+        // as WavetableOsc::freq(); lanes without a note read the lowest saw
+        // table, at zero amplitude
+        g.table[l] = WavetableBank::offset(WAVE_SAW, p.frequency);
+        g.noteInc[l] = (uint32_t)(int64_t)(p.frequency / sampleRate * 4294967296.0);
+        g.inc[l] = 0;
+        g.phase[l] = 0;
+
+        g.wSaw[l] = (1.0f - p.oscMix) * (1.0f - p.noise);
+        g.wSqr[l] = p.oscMix * (1.0f - p.noise);
+        g.wNoise[l] = p.noise;
+
+        g.filtFreq[l] = p.filtFreq;
+        g.filtDepth[l] = p.filtEnvDpth;
+        g.filtRes[l] = p.filtRes < 0.01f ? 0.01f : p.filtRes;
+        g.d1[l] = g.d2[l] = 0.0f;
+        g.fresh[l] = true;
+        cancelRelease(g, l);
+
+        g.amp[l] = p.amplitude;
+        // equal-power pan, pan = -1 (left) to 1 (right)
+        float theta = (p.pan + 1.0f) * 0.785398163f;
+        g.panL[l] = std::cos(theta);
+        g.panR[l] = std::sin(theta);
+
+        EnvLanes &a = g.ampEnv;
+        a.atk[l] = p.ampEnvAtk, a.dec[l] = p.ampEnvDec, a.sus[l] = p.ampEnvSus;
+        a.rel[l] = p.ampEnvRel, a.curve[l] = p.ampEnvCve;
+        a.stage[l] = ENV_WAIT;
+        holdSegment(a, l, 0.0f, 0);
+
+        EnvLanes &f = g.filtEnv;
+        f.atk[l] = p.filtEnvAtk, f.dec[l] = p.filtEnvDec, f.sus[l] = p.filtEnvSus;
+        f.rel[l] = p.filtEnvRel, f.curve[l] = p.filtEnvCve;
+        f.stage[l] = ENV_WAIT;
+        holdSegment(f, l, 0.0f, 0);
+    }
+
+    // Delay the start of a just-triggered note to frame offset of this block
+    void startAt(int lane, int offset)
+    {
+        Group &g = group(lane);
+        int l = lane % W;
+        if (g.ampEnv.stage[l] == ENV_WAIT)
+        {
+            g.ampEnv.left[l] = offset;
+            g.filtEnv.left[l] = offset;
+        }
+    }
+
+    void noteOff(int lane)
+    {
+        Group &g = group(lane);
+        int l = lane % W;
+        release(g.ampEnv, l);
+        release(g.filtEnv, l);
+        cancelRelease(g, l);
+    }
+
+    // Release a note over seconds instead of its own release time, e.g. to
+    // steal its lane
+    void fadeOut(int lane, float seconds)
+    {
+        Group &g = group(lane);
+        int l = lane % W;
+        g.ampEnv.rel[l] = g.filtEnv.rel[l] = seconds;
+        noteOff(lane);
+    }
+
+    // Current output level of a lane: amplitude times its envelope
+    float level(int lane)
+    {
+        Group &g = group(lane);
+        int l = lane % W;
+        return g.ampEnv.value[l] * g.amp[l];
+    }
+
+    // Release a note at frame offset of the next render() block
+    void noteOffAt(int lane, int offset)
+    {
+        Group &g = group(lane);
+        int l = lane % W;
+        if (g.releaseIn[l] == HOLD)
+            g.numReleases++;
+        g.releaseIn[l] = offset;
+    }
+
+    // True once the lane's note has been released (its release may still
+    // be sounding)
+    bool released(int lane)
+    {
+        Group &g = group(lane);
+        int stage = g.ampEnv.stage[lane % W];
+        return stage == ENV_RELEASE || stage == ENV_DONE;
+    }
+
+    // True once the lane's amplitude envelope has finished
+    bool done(int lane)
+    {
+        Group &g = group(lane);
+        return g.ampEnv.stage[lane % W] == ENV_DONE;
+    }
+
+    // Render every active lane and add it into the stereo output. Blocks
+    // longer than MAX_FRAMES are rendered MAX_FRAMES at a time; startAt()
+    // and noteOffAt() offsets count down across the pieces, so they can be
+    // anywhere in the whole block.
+    void render(float *left, float *right, int frames)
+    {
+        for (int start = 0; start < frames; start += MAX_FRAMES)
+        {
+            int n = frames - start < MAX_FRAMES ? frames - start : MAX_FRAMES;
+            renderChunk(left + start, right + start, n);
+        }
+    }
+};
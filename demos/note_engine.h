@@ -0,0 +1,541 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Gamma/Domain.h"
+
+#include "al/graphics/al_Graphics.hpp"
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_SynthVoice.hpp"
+#include "al/ui/al_Imgui.hpp"
+
+#include "audio_profiler.h"
+#include "event_scheduler.h"
+#include "note_feed.h"
+#include "offline_render.h"
+#include "polyphony.h"
+#include "sequence.h"
+#include "sequence_file.h"
+#include "spsc_queue.h"
+#include "voice_pool.h"
+
+// Events handed from the GUI/keyboard thread to the audio thread
+struct NoteEvent
+{
+    enum Type : uint8_t
+    {
+        NOTE_ON,    // start a note, held until NOTE_OFF if duration <= 0
+        NOTE_OFF,    // release the held note with this id
+        PATCH_PARAM, // set field param of an instrument's patch to value
+        NOTE_RELEASE // audio thread only: end a timed note started on voice
+    };
+
+    Type type;
+    uint8_t instrument;
+    uint16_t param;
+    int id;
+    uint64_t frame; // audio frame the event is due on
+    float freq, amp, attack, decay;
+    float duration; // seconds
+    float value;
+    al::SynthVoice *voice;
+};
+
+// capacity of the event queue, and how far past the block being rendered
+// newly queued events are stamped, so notes queued together keep their
+// relative timing to the sample
+static const int EVENT_QUEUE_SIZE = 4096;
+static const int EVENT_LATENCY_FRAMES = 512;
+
+// songs are queued this far ahead of the audio clock by default (see
+// lookahead()), topped up every FEED_PERIOD_MS by a thread of their own,
+// or per block when bouncing. The GUI thread doesn't feed them, so a
+// stalled frame doesn't delay notes; only a feed thread held off for
+// longer than the look-ahead makes them late (not lost).
+static const float LOOKAHEAD_SECONDS = 0.2f;
+static const float MIN_LOOKAHEAD_SECONDS = 0.05f; // a few feed periods
+static const float MAX_LOOKAHEAD_SECONDS = 2.0f;
+static const int FEED_PERIOD_MS = 10;
+
+// events waiting on the audio thread for their frame; every note that
+// starts files its release in the slot it leaves, so this only has to hold
+// what the two queues can
+static const int EVENT_SCHEDULER_SIZE = 4 * EVENT_QUEUE_SIZE;
+// held notes (noteOn() without noteOff() yet) that can be released to the sample
+static const int MAX_HELD_NOTES = 64;
+
+// One of the instruments a NoteEngine plays, by its index in the table
+// the engine is built on
+struct InstrumentSpec
+{
+    const char *name;           // as stored in .gseq sequence files
+    VoicePoolBase &(*voices)(); // the voices its notes take
+    int maxVoices;              // notes it may play at once
+    float pitch;                // factor note frequencies are scaled by
+};
+
+// Notes, held notes, patch changes and songs from any thread, played
+// sample-accurately on the audio thread with voices from the instruments'
+// VoicePools.
+//
+// Events are queued to the audio thread, which calls beginBlock(), render()
+// and endBlock() around the rest of its callback. Songs are fed a
+// look-ahead window at a time by a thread of their own (startFeeding()),
+// or per block by bounce(). Polyphony caps the notes playing, by instrument
+// and by CPU load.
+template <int MAX_VOICES, int NUM_INSTRUMENTS>
+class NoteEngine
+{
+private:
+    const InstrumentSpec *mInstruments;
+
+    // Note and patch events from the GUI/keyboard thread, drained by
+    // beginBlock()
+    SpscQueue<NoteEvent, EVENT_QUEUE_SIZE> mEvents;
+    // song notes from the feed thread (from bounce() when bouncing),
+    // drained with mEvents
+    SpscQueue<NoteEvent, EVENT_QUEUE_SIZE> mSongEvents;
+    // first frame of the block the audio thread is rendering
+    std::atomic<uint64_t> mAudioFrame{0};
+    int mDroppedEvents = 0;
+    // songs being queued a window at a time, see feedNotes(); mFeed and
+    // mFeeding are guarded by mFeedLock
+    NoteFeed mFeed;
+    std::mutex mFeedLock;
+    std::condition_variable mFeedWake;
+    std::thread mFeedThread;
+    bool mFeeding = false;
+    std::atomic<float> mLookahead{LOOKAHEAD_SECONDS};
+
+    // Audio thread: drained events waiting for their frame, and the voices
+    // playing held notes
+    EventScheduler<NoteEvent, EVENT_SCHEDULER_SIZE> mScheduler;
+    struct HeldNote
+    {
+        int id;
+        int instrument;
+        al::SynthVoice *voice; // nullptr: free slot
+    };
+    HeldNote mHeld[MAX_HELD_NOTES] = {};
+    Polyphony<MAX_VOICES, NUM_INSTRUMENTS> mPolyphony;
+    // the voices taken from the pools that are playing, and the id the
+    // next note started without one gets (counted from 1000 like PolySynth)
+    VoicePlayer mVoices;
+    int mNextId = 1000;
+    std::chrono::steady_clock::time_point mBlockStart;
+
+    VoicePoolBase &voices(int instrument) const { return mInstruments[instrument].voices(); }
+
+    // Whether instrument is the first in the table to play its pool, so
+    // each pool is visited once
+    bool firstOfPool(int instrument) const
+    {
+        for (int i = 0; i < instrument; i++)
+            if (&voices(i) == &voices(instrument))
+                return false;
+        return true;
+    }
+
+    // Audio thread: start the note of a NOTE_ON event offset frames into
+    // the block starting on frame blockStart
+    void startNote(const NoteEvent &e, int offset, uint64_t blockStart)
+    {
+        int instrument = e.instrument;
+        if (instrument >= NUM_INSTRUMENTS)
+            return;
+        mPolyphony.makeRoom(instrument, blockStart, level(), steal());
+
+        VoicePoolBase &pool = voices(instrument);
+        al::SynthVoice *voice = pool.take(instrument, e.amp, e.freq * mInstruments[instrument].pitch);
+        if (!voice)
+            return;
+        int id = e.id >= 0 ? e.id : mNextId++;
+        if (!mVoices.start(voice, pool, id, offset))
+            return;
+        mPolyphony.add(voice, id, instrument, blockStart + offset);
+        if (e.duration > 0.0f)
+        {
+            // file the release in the slot this event left
+            NoteEvent release = e;
+            release.type = NoteEvent::NOTE_RELEASE;
+            release.id = id;
+            release.voice = voice;
+            mScheduler.schedule(blockStart + offset + (uint64_t)std::llround(e.duration * gam::sampleRate()), release);
+            return;
+        }
+        for (HeldNote &h : mHeld)
+            if (!h.voice)
+            {
+                h = {id, instrument, voice};
+                return;
+            }
+        // no slot: noteOff() will still release it, at the next block
+    }
+
+    // Audio thread: level and stealing of a playing note, for mPolyphony
+    auto level() const
+    {
+        return [this](al::SynthVoice *voice, int instrument) { return voices(instrument).level(voice); };
+    }
+
+    auto steal() const
+    {
+        return [this](al::SynthVoice *voice, int instrument) { voices(instrument).steal(voice); };
+    }
+
+    // Audio thread: release the held note id
+    void releaseHeld(int id, int offset)
+    {
+        for (HeldNote &h : mHeld)
+            if (h.voice && h.id == id)
+            {
+                if (h.voice->active() && h.voice->id() == id)
+                    voices(h.instrument).releaseAt(h.voice, offset);
+                h.voice = nullptr;
+                return;
+            }
+        mVoices.release(id, offset);
+    }
+
+    void queueEvent(const NoteEvent &e)
+    {
+        if (!mEvents.push(e))
+            mDroppedEvents++;
+    }
+
+    // Feed thread, or bounce() with no feed thread running; mFeedLock held:
+    // queue the notes of the songs playing that start within the look-ahead
+    // of the block being rendered. Notes the queue can't take wait for the
+    // next call.
+    void feedNotes()
+    {
+        double sampleRate = gam::sampleRate();
+        float seconds = mLookahead.load(std::memory_order_relaxed);
+        uint64_t until = eventClock() + (uint64_t)std::llround(seconds * sampleRate);
+        mFeed.feed(until, sampleRate, [this](const FedNote &n) {
+            return mSongEvents.push(
+                noteEvent(n.freq, n.time, n.duration, n.amp, n.attack, n.decay, n.instrument, n.start));
+        });
+    }
+
+public:
+    explicit NoteEngine(const InstrumentSpec (&instruments)[NUM_INSTRUMENTS]) : mInstruments(instruments) {}
+    ~NoteEngine() { stopFeeding(); }
+
+    // Preallocate poolSize voices in each instrument's pool and set the
+    // polyphony limits before any audio runs; cpuBudget and minVoices as
+    // Polyphony::budget() takes them
+    void allocate(int poolSize, float cpuBudget, int minVoices)
+    {
+        int playing = 0;
+        for (int i = 0; i < NUM_INSTRUMENTS; i++)
+        {
+            mPolyphony.limit(i, mInstruments[i].maxVoices);
+            if (firstOfPool(i))
+            {
+                voices(i).allocate(poolSize);
+                playing += voices(i).size();
+            }
+        }
+        mPolyphony.budget(cpuBudget, minVoices);
+        mVoices.reserve(playing);
+    }
+
+    // --- audio thread ---
+
+    // Move everything queued since the last block into the scheduler, then
+    // apply the events due in this block in frame order, each at its own
+    // frame. Call first thing in the audio callback.
+    void beginBlock(al::AudioIOData &io)
+    {
+        mBlockStart = std::chrono::steady_clock::now();
+        uint64_t blockStart = mAudioFrame.load(std::memory_order_relaxed);
+        mPolyphony.prune();
+        mPolyphony.enforce(blockStart, level(), steal());
+
+        NoteEvent e;
+        while (mScheduler.size() < mScheduler.capacity() && mEvents.pop(e))
+            mScheduler.schedule(e.frame, e);
+        while (mScheduler.size() < mScheduler.capacity() && mSongEvents.pop(e))
+            mScheduler.schedule(e.frame, e);
+
+        uint64_t frame;
+        while (mScheduler.next(blockStart + io.framesPerBuffer(), frame, e))
+        {
+            int offset = blockOffset(frame, blockStart); // late: as soon as we can
+            switch (e.type)
+            {
+            case NoteEvent::NOTE_ON:
+                startNote(e, offset, blockStart);
+                break;
+            case NoteEvent::NOTE_OFF:
+                releaseHeld(e.id, offset);
+                break;
+            case NoteEvent::NOTE_RELEASE:
+                // the voice may have been stolen or freed since
+                if (e.voice->active() && e.voice->id() == e.id)
+                    voices(e.instrument).releaseAt(e.voice, offset);
+                break;
+            case NoteEvent::PATCH_PARAM:
+            {
+                if (e.instrument >= NUM_INSTRUMENTS)
+                    break;
+                int count;
+                float *fields = voices(e.instrument).patchFields(e.instrument, count);
+                if (e.param < count)
+                    fields[e.param] = e.value;
+                break;
+            }
+            }
+        }
+    }
+
+    // Render the notes playing into io
+    void render(al::AudioIOData &io) { mVoices.render(io); }
+
+    // Advance the clock past the block and feed its load to the polyphony
+    // cap. Call last thing in the audio callback.
+    void endBlock(al::AudioIOData &io)
+    {
+        mAudioFrame.store(mAudioFrame.load(std::memory_order_relaxed) + io.framesPerBuffer(),
+                          std::memory_order_release);
+        float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - mBlockStart).count();
+        mPolyphony.callbackLoad(seconds * io.framesPerSecond() / io.framesPerBuffer());
+    }
+
+    // --- any other thread ---
+
+    // Graphics thread: draw the notes playing
+    void render(al::Graphics &g)
+    {
+        for (int i = 0; i < NUM_INSTRUMENTS; i++)
+            if (firstOfPool(i))
+                voices(i).render(g);
+    }
+
+    // Frame a note queued now with time 0 starts on
+    uint64_t eventClock() { return mAudioFrame.load(std::memory_order_acquire) + EVENT_LATENCY_FRAMES; }
+
+    // Queue a note: time and duration are in seconds, time counted from
+    // frame start (0: from now). Pass the same start to keep several
+    // notes or sequences in time with each other.
+    void playNote(float freq, float time, float duration = 0.5, float amp = 0.2, float attack = 0.1, float decay = 0.1, int instrument = 0, uint64_t start = 0)
+    {
+        queueEvent(noteEvent(freq, time, duration, amp, attack, decay, instrument, start));
+    }
+
+    // The event playNote() queues
+    NoteEvent noteEvent(float freq, float time, float duration, float amp, float attack, float decay, int instrument, uint64_t start)
+    {
+        NoteEvent e = {};
+        e.type = NoteEvent::NOTE_ON;
+        e.instrument = (uint8_t)instrument;
+        e.id = -1;
+        e.frame = (start ? start : eventClock()) + (uint64_t)std::llround(time * gam::sampleRate());
+        e.freq = freq;
+        e.amp = amp;
+        e.attack = attack;
+        e.decay = decay;
+        e.duration = duration;
+        return e;
+    }
+
+    // Start a note that holds until noteOff(id)
+    void noteOn(int id, float freq, float amp = 0.2, int instrument = 0)
+    {
+        NoteEvent e = {};
+        e.type = NoteEvent::NOTE_ON;
+        e.instrument = (uint8_t)instrument;
+        e.id = id;
+        e.frame = eventClock();
+        e.freq = freq;
+        e.amp = amp;
+        queueEvent(e);
+    }
+
+    void noteOff(int id)
+    {
+        NoteEvent e = {};
+        e.type = NoteEvent::NOTE_OFF;
+        e.id = id;
+        e.frame = eventClock();
+        queueEvent(e);
+    }
+
+    // Change one field of an instrument's patch for notes started from now
+    // on; param comes from patchParam()
+    void setPatchParam(int instrument, uint16_t param, float value)
+    {
+        NoteEvent e = {};
+        e.type = NoteEvent::PATCH_PARAM;
+        e.instrument = (uint8_t)instrument;
+        e.param = param;
+        e.frame = eventClock();
+        e.value = value;
+        queueEvent(e);
+    }
+
+    // bpm is beats per minute
+
+    // Play s from frame start (0: from now): its notes are queued from a
+    // NoteStream the look-ahead ahead of the audio clock as it plays
+    void playSequence(Sequence *s, float bpm, int instrument = 0, uint64_t start = 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mFeedLock);
+            mFeed.add(s, bpm, instrument, start ? start : eventClock());
+        }
+        mFeedWake.notify_one(); // its first notes may be due now
+    }
+
+    // Play a mapped .gseq file from now, reading the records in place as
+    // they come due (see feedNotes()); file must stay open until it has
+    // played or clearSongs() is called. Notes on instruments this engine
+    // doesn't have are skipped.
+    void playSequenceFile(const MappedSequence &file, float bpm)
+    {
+        int instruments[SEQUENCE_FILE_MAX_INSTRUMENTS];
+        for (int i = 0; i < file.numInstruments(); i++)
+        {
+            instruments[i] = -1;
+            for (int k = 0; k < NUM_INSTRUMENTS; k++)
+                if (std::strcmp(file.instrumentName(i), mInstruments[k].name) == 0)
+                    instruments[i] = k;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mFeedLock);
+            mFeed.add(file, instruments, bpm, eventClock());
+        }
+        mFeedWake.notify_one();
+    }
+
+    // Stop every song, leaving the notes already queued to play out
+    void clearSongs()
+    {
+        std::lock_guard<std::mutex> lock(mFeedLock);
+        mFeed.clear();
+    }
+
+    // Write notes, numbered by this engine's instruments, as a .gseq file
+    bool writeSequence(const char *path, const std::vector<PackedNote> &notes, float bpm)
+    {
+        const char *names[NUM_INSTRUMENTS];
+        for (int i = 0; i < NUM_INSTRUMENTS; i++)
+            names[i] = mInstruments[i].name;
+        return writeSequenceFile(path, notes.data(), (int)notes.size(), bpm, names, NUM_INSTRUMENTS);
+    }
+
+    // How far ahead of the audio clock songs are queued, in seconds, from
+    // MIN_LOOKAHEAD_SECONDS to MAX_LOOKAHEAD_SECONDS. Longer rides out
+    // longer stalls of the feed thread, at the cost of more events waiting
+    // in the scheduler. Safe to call from any thread.
+    void lookahead(float seconds)
+    {
+        seconds = std::min(std::max(seconds, MIN_LOOKAHEAD_SECONDS), MAX_LOOKAHEAD_SECONDS);
+        mLookahead.store(seconds, std::memory_order_relaxed);
+        mFeedWake.notify_one();
+    }
+
+    // Start the thread that feeds the songs every FEED_PERIOD_MS, and as
+    // soon as one is added
+    void startFeeding()
+    {
+        std::lock_guard<std::mutex> lock(mFeedLock);
+        if (mFeeding)
+            return;
+        mFeeding = true;
+        mFeedThread = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mFeedLock);
+            while (mFeeding)
+            {
+                feedNotes();
+                mFeedWake.wait_for(lock, std::chrono::milliseconds(FEED_PERIOD_MS));
+            }
+        });
+    }
+
+    void stopFeeding()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mFeedLock);
+            if (!mFeeding)
+                return;
+            mFeeding = false;
+        }
+        mFeedWake.notify_one();
+        mFeedThread.join();
+    }
+
+    // Render the notes scheduled so far offline through renderBlock (the
+    // app's whole audio callback), as fast as the CPU allows, streaming
+    // them to a WAV file at path. io must be set up as bounceToWav() takes
+    // it. Renders at least seconds of audio, then until every voice has
+    // finished, for at most maxTail seconds more. Needs no audio device and
+    // feeds the songs itself; don't call it while audio is running.
+    template <class RenderBlock>
+    BounceStats bounce(const char *path, al::AudioIOData &io, float seconds, float maxTail, RenderBlock renderBlock)
+    {
+        BounceStats stats = bounceToWav(
+            path, io,
+            [&](al::AudioIOData &block) {
+                {
+                    std::lock_guard<std::mutex> lock(mFeedLock);
+                    feedNotes(); // no feed thread here to top up the queue
+                }
+                renderBlock(block);
+            },
+            [&](double t) {
+                return t >= seconds + maxTail || (t >= seconds && mFeed.empty() && mVoices.size() == 0);
+            });
+        std::cout << "bounced " << stats.audioSeconds << " s to " << path << " in "
+                  << stats.renderSeconds << " s (" << stats.realTimeFactor << "x real time)" << std::endl;
+        return stats;
+    }
+
+    // GUI thread, between imguiBeginFrame() and imguiEndFrame(): the song
+    // controls
+    void drawControls()
+    {
+        ImGui::Begin("Songs");
+        float seconds = mLookahead.load(std::memory_order_relaxed);
+        if (ImGui::SliderFloat("look-ahead (s)", &seconds, MIN_LOOKAHEAD_SECONDS, MAX_LOOKAHEAD_SECONDS))
+            lookahead(seconds);
+        ImGui::End();
+    }
+};
+
+// GUI thread, between imguiBeginFrame() and imguiEndFrame(): callback and
+// voice timings over the last PROFILE_WINDOW callbacks
+inline void drawProfiler(AudioProfiler &profiler)
+{
+    ProfileStats s = profiler.stats();
+    ImGui::Begin("Audio profiler");
+    ImGui::Text("callbacks %llu  deadline misses %llu  dropped %llu", (unsigned long long)s.callbacks,
+                (unsigned long long)s.deadlineMisses, (unsigned long long)s.dropped);
+    ImGui::Text("budget %.0f us  worst %.0f us", s.budgetUs, s.worstUs);
+    ImGui::Separator();
+    ImGui::Text("%-14s %8s %8s %8s", "", "p50", "p99", "max");
+    ImGui::Text("%-14s %8.0f %8.0f %8.0f", "callback us", s.callbackUs.p50, s.callbackUs.p99, s.callbackUs.max);
+    ImGui::Text("%-14s %8.1f %8.1f %8.1f", "load %", 100.0f * s.load.p50, 100.0f * s.load.p99,
+                100.0f * s.load.max);
+    for (int k = 0; k < profiler.numKinds(); k++)
+    {
+        ImGui::Separator();
+        ImGui::Text("%s", profiler.kindName(k));
+        ImGui::Text("%-14s %8.2f %8.2f %8.2f", "  us per voice", s.voiceUs[k].p50, s.voiceUs[k].p99,
+                    s.voiceUs[k].max);
+        ImGui::Text("%-14s %8.0f %8.0f %8.0f", "  voices", s.voices[k].p50, s.voices[k].p99, s.voices[k].max);
+    }
+    ImGui::End();
+}
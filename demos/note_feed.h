@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "sequence.h"
+#include "sequence_file.h"
+
+// A note handed on by NoteFeed: time and duration in seconds, time counted
+// from frame start, as playNote() takes them
+struct FedNote
+{
+    uint64_t start;
+    float time, duration;
+    float freq, amp, attack, decay;
+    int instrument;
+};
+
+// Songs played a look-ahead window at a time.
+//
+// Instead of queueing a whole song for the audio thread at once, which
+// overflows the event queue on long songs and keeps the scheduler full of
+// notes minutes away, each song is added here as a track: a NoteStream
+// over a Sequence tree, or a .gseq file read in place. feed() hands on
+// only the notes starting before a given frame, typically the audio clock
+// plus a few hundred milliseconds, and is called again as the clock
+// advances. A note the receiver can't take is offered again on the next
+// call, so nothing is dropped.
+//
+// Tracks keep pointers to their sequence or file, which must stay valid
+// until the track ends or clear() is called. Only one thread at a time may
+// use a NoteFeed.
+//
+// Room for NOTE_FEED_TRACKS tracks of each kind is made up front, so
+// adding a song to replay it doesn't allocate (a .gseq file not in time
+// order still gets its index).
+static const int NOTE_FEED_TRACKS = 16;
+
+class NoteFeed
+{
+private:
+    struct SequenceTrack
+    {
+        NoteStream notes;
+        int instrument;
+        uint64_t start;
+        float secondsPerBeat;
+        Note pending;
+        bool hasPending;
+    };
+
+    struct FileTrack
+    {
+        const MappedSequence *file;
+        std::vector<uint32_t> order; // notes by start time, empty if the file already is
+        uint32_t next;
+        int instruments[SEQUENCE_FILE_MAX_INSTRUMENTS]; // demo instrument, -1 to skip
+        uint64_t start;
+        float secondsPerBeat;
+    };
+
+    std::vector<SequenceTrack> mSequences;
+    std::vector<FileTrack> mFiles;
+
+    static uint64_t frameOf(uint64_t start, float seconds, double sampleRate)
+    {
+        return start + (uint64_t)std::llround(seconds * sampleRate);
+    }
+
+    template <class Play>
+    static bool feedTrack(SequenceTrack &t, uint64_t until, double sampleRate, Play &play)
+    {
+        for (;;)
+        {
+            if (!t.hasPending && !t.notes.next(t.pending))
+                return false; // ended
+            t.hasPending = true;
+            Note &n = t.pending;
+            float time = n.getTime() * t.secondsPerBeat;
+            if (frameOf(t.start, time, sampleRate) >= until)
+                return true;
+            FedNote fed = {t.start, time, n.getDuration() * t.secondsPerBeat, n.getFreq(), n.getAmp(),
+                           n.getAttack(), n.getDecay(), t.instrument};
+            if (!play(fed))
+                return true;
+            t.hasPending = false;
+        }
+    }
+
+    template <class Play>
+    static bool feedTrack(FileTrack &t, uint64_t until, double sampleRate, Play &play)
+    {
+        const PackedNote *notes = t.file->notes();
+        for (; t.next < (uint32_t)t.file->size(); t.next++)
+        {
+            const PackedNote &n = notes[t.order.empty() ? t.next : t.order[t.next]];
+            if (n.instrument >= (uint32_t)t.file->numInstruments() || t.instruments[n.instrument] < 0)
+                continue;
+            float time = n.time * t.secondsPerBeat;
+            if (frameOf(t.start, time, sampleRate) >= until)
+                return true;
+            FedNote fed = {t.start, time, n.duration * t.secondsPerBeat, n.freq, n.amp, n.attack, n.decay,
+                           t.instruments[n.instrument]};
+            if (!play(fed))
+                return true;
+        }
+        return false;
+    }
+
+public:
+    NoteFeed()
+    {
+        mSequences.reserve(NOTE_FEED_TRACKS);
+        mFiles.reserve(NOTE_FEED_TRACKS);
+    }
+
+    // Play s on instrument at bpm, its beat 0 on frame start
+    void add(Sequence *s, float bpm, int instrument, uint64_t start)
+    {
+        mSequences.push_back({NoteStream(s), instrument, start, 60.0f / bpm, Note(), false});
+    }
+
+    // Play file at bpm from frame start. instruments maps each of the
+    // file's instruments to the demo's, or to -1 to skip its notes.
+    void add(const MappedSequence &file, const int *instruments, float bpm, uint64_t start)
+    {
+        FileTrack t;
+        t.file = &file;
+        t.next = 0;
+        for (int i = 0; i < SEQUENCE_FILE_MAX_INSTRUMENTS; i++)
+            t.instruments[i] = i < file.numInstruments() ? instruments[i] : -1;
+        t.start = start;
+        t.secondsPerBeat = 60.0f / bpm;
+
+        // a file in time order (any writeSequenceFile() wrote) is read
+        // straight through; others get an index
+        if (!file.sorted())
+        {
+            const PackedNote *notes = file.notes();
+            t.order.resize(file.size());
+            for (int k = 0; k < file.size(); k++)
+                t.order[k] = (uint32_t)k;
+            std::stable_sort(t.order.begin(), t.order.end(),
+                             [notes](uint32_t a, uint32_t b) { return notes[a].time < notes[b].time; });
+        }
+        mFiles.push_back(std::move(t));
+    }
+
+    // Hand play(const FedNote &) every note starting before frame until, in
+    // time order within each track. play returns false when it can take no
+    // more; that note is offered again by the next call. Finished tracks
+    // are dropped.
+    template <class Play>
+    void feed(uint64_t until, double sampleRate, Play play)
+    {
+        for (size_t i = 0; i < mSequences.size();)
+            if (feedTrack(mSequences[i], until, sampleRate, play))
+                i++;
+            else
+                mSequences.erase(mSequences.begin() + i);
+        for (size_t i = 0; i < mFiles.size();)
+            if (feedTrack(mFiles[i], until, sampleRate, play))
+                i++;
+            else
+                mFiles.erase(mFiles.begin() + i);
+    }
+
+    // Tracks still playing
+    int size() const { return (int)(mSequences.size() + mFiles.size()); }
+    bool empty() const { return size() == 0; }
+
+    void clear()
+    {
+        mSequences.clear();
+        mFiles.clear();
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+// Note names and note-number-to-frequency tables, all computed at compile
+// time.
+//
+// Note names are MIDI note numbers, sharps spelled with an s: A4 = 69,
+// Cs5 = 73. A NoteTable maps all 128 MIDI notes to frequencies; reading one
+// is an array load, and with a constant note the compiler folds it to the
+// frequency itself. Tables are built by constexpr functions, so a tuning
+// costs nothing at startup:
+//
+//   equalTemperament(reference, referenceNote, divisions)
+//       divisions equal steps per octave, referenceNote at reference Hz
+//   scaleTuning(ratios, rootNote, rootFreq, period)
+//       a scale of ratios from its root (ratios[0] == 1), repeating every
+//       period (2 for octaves), rootNote at rootFreq Hz
+//
+// MIDI_440, MIDI_432 and MIDI_JUST_C are ready-made.
+enum MidiNote
+{
+    C0 = 12, Cs0, D0, Ds0, E0, F0, Fs0, G0, Gs0, A0, As0, B0,
+    C1 = 24, Cs1, D1, Ds1, E1, F1, Fs1, G1, Gs1, A1, As1, B1,
+    C2 = 36, Cs2, D2, Ds2, E2, F2, Fs2, G2, Gs2, A2, As2, B2,
+    C3 = 48, Cs3, D3, Ds3, E3, F3, Fs3, G3, Gs3, A3, As3, B3,
+    C4 = 60, Cs4, D4, Ds4, E4, F4, Fs4, G4, Gs4, A4, As4, B4,
+    C5 = 72, Cs5, D5, Ds5, E5, F5, Fs5, G5, Gs5, A5, As5, B5,
+    C6 = 84, Cs6, D6, Ds6, E6, F6, Fs6, G6, Gs6, A6, As6, B6,
+    C7 = 96, Cs7, D7, Ds7, E7, F7, Fs7, G7, Gs7, A7, As7, B7,
+    C8 = 108, Cs8, D8, Ds8, E8, F8, Fs8, G8, Gs8, A8, As8, B8,
+    C9 = 120, Cs9, D9, Ds9, E9, F9, Fs9, G9,
+};
+
+static const int MIDI_NOTES = 128;
+
+struct NoteTable
+{
+    float freq[MIDI_NOTES];
+
+    // Frequency of note, clamped to 0..127
+    constexpr float operator[](int note) const { return freq[note < 0 ? 0 : note > MIDI_NOTES - 1 ? MIDI_NOTES - 1 : note]; }
+};
+
+// base^exponent for a whole exponent
+constexpr double powInt(double base, int exponent)
+{
+    double result = 1.0;
+    for (int i = 0; i < (exponent < 0 ? -exponent : exponent); i++)
+        result *= base;
+    return exponent < 0 ? 1.0 / result : result;
+}
+
+// The n-th root of x > 0 by Newton's method
+constexpr double rootOf(double x, int n)
+{
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 200; i++)
+    {
+        double next = r - (powInt(r, n) - x) / (n * powInt(r, n - 1));
+        if (next == r)
+            break;
+        r = next;
+    }
+    return r;
+}
+
+constexpr NoteTable equalTemperament(double reference, int referenceNote = A4, int divisions = 12)
+{
+    NoteTable t{};
+    double step = rootOf(2.0, divisions);
+    for (int note = 0; note < MIDI_NOTES; note++)
+    {
+        // whole octaves exactly, then the steps left over
+        int steps = note - referenceNote;
+        int octaves = steps >= 0 ? steps / divisions : -((-steps + divisions - 1) / divisions);
+        t.freq[note] = (float)(reference * powInt(2.0, octaves) * powInt(step, steps - octaves * divisions));
+    }
+    return t;
+}
+
+template <int N>
+constexpr NoteTable scaleTuning(const double (&ratios)[N], int rootNote, double rootFreq, double period = 2.0)
+{
+    NoteTable t{};
+    for (int note = 0; note < MIDI_NOTES; note++)
+    {
+        int steps = note - rootNote;
+        int periods = steps >= 0 ? steps / N : -((-steps + N - 1) / N);
+        t.freq[note] = (float)(rootFreq * powInt(period, periods) * ratios[steps - periods * N]);
+    }
+    return t;
+}
+
+// 5-limit just intonation, C major-centred
+static constexpr double JUST_RATIOS[12] = {1.0,       16.0 / 15, 9.0 / 8,  6.0 / 5, 5.0 / 4,  4.0 / 3,
+                                            45.0 / 32, 3.0 / 2,   8.0 / 5,  5.0 / 3, 9.0 / 5,  15.0 / 8};
+
+static constexpr NoteTable MIDI_440 = equalTemperament(440.0);
+static constexpr NoteTable MIDI_432 = equalTemperament(432.0);
+// just intonation from C4 at its equal-tempered 440 Hz frequency
+static constexpr NoteTable MIDI_JUST_C = scaleTuning(JUST_RATIOS, C4, MIDI_440.freq[C4]);
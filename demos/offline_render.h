@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+// Streaming WAV file writer (32-bit float, interleaved).
+//
+// The header is written with placeholder sizes when the file is opened and
+// patched in close(), so a song is written block by block and never has to
+// be held in memory.
+class WavWriter
+{
+private:
+    std::FILE *mFile = nullptr;
+    int mChannels = 0;
+    uint32_t mFrames = 0;
+    std::vector<float> mInterleaved;
+
+    void put16(uint16_t v) { std::fwrite(&v, 2, 1, mFile); }
+    void put32(uint32_t v) { std::fwrite(&v, 4, 1, mFile); }
+
+    // RIFF/WAVE header for IEEE float data; sizes are filled in by close()
+    void header(int sampleRate, uint32_t dataBytes)
+    {
+        std::fwrite("RIFF", 1, 4, mFile);
+        put32(36 + dataBytes);
+        std::fwrite("WAVEfmt ", 1, 8, mFile);
+        put32(16);
+        put16(3); // WAVE_FORMAT_IEEE_FLOAT
+        put16((uint16_t)mChannels);
+        put32((uint32_t)sampleRate);
+        put32((uint32_t)sampleRate * mChannels * 4);
+        put16((uint16_t)(mChannels * 4));
+        put16(32);
+        std::fwrite("data", 1, 4, mFile);
+        put32(dataBytes);
+    }
+
+public:
+    ~WavWriter() { close(); }
+
+    bool open(const char *path, int sampleRate, int channels, int maxFrames)
+    {
+        close();
+        mFile = std::fopen(path, "wb");
+        if (!mFile)
+            return false;
+        mChannels = channels;
+        mFrames = 0;
+        mInterleaved.resize((size_t)maxFrames * channels);
+        header(sampleRate, 0);
+        return true;
+    }
+
+    // Append frames frames of channel buffers (maxFrames at most)
+    void write(const float *const *channels, int frames)
+    {
+        for (int i = 0; i < frames; i++)
+            for (int ch = 0; ch < mChannels; ch++)
+                mInterleaved[i * mChannels + ch] = channels[ch][i];
+        std::fwrite(mInterleaved.data(), sizeof(float), (size_t)frames * mChannels, mFile);
+        mFrames += frames;
+    }
+
+    uint32_t frames() const { return mFrames; }
+
+    void close()
+    {
+        if (!mFile)
+            return;
+        uint32_t dataBytes = mFrames * mChannels * 4;
+        std::fseek(mFile, 4, SEEK_SET);
+        put32(36 + dataBytes);
+        std::fseek(mFile, 40, SEEK_SET);
+        put32(dataBytes);
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+};
+
+struct BounceStats
+{
+    double audioSeconds;
+    double renderSeconds;
+    double realTimeFactor; // seconds of audio rendered per second of CPU time
+};
+
+// Render blocks with render(io) as fast as possible, streaming them to
+// path, until done(seconds rendered so far) returns true. io must already
+// be set up with the sample rate, block size and channel count to use.
+template <class RenderBlock, class Done>
+BounceStats bounceToWav(const char *path, al::AudioIOData &io, RenderBlock render, Done done)
+{
+    BounceStats stats = {0.0, 0.0, 0.0};
+    int channels = io.channelsOut();
+    int frames = io.framesPerBuffer();
+    double sampleRate = io.framesPerSecond();
+
+    WavWriter wav;
+    if (!wav.open(path, (int)sampleRate, channels, frames))
+    {
+        std::fprintf(stderr, "bounceToWav: can't open %s\n", path);
+        return stats;
+    }
+
+    std::vector<const float *> buffers(channels);
+    auto start = std::chrono::steady_clock::now();
+    while (!done(wav.frames() / sampleRate))
+    {
+        io.zeroOut();
+        render(io);
+        for (int ch = 0; ch < channels; ch++)
+            buffers[ch] = io.outBuffer(ch);
+        wav.write(buffers.data(), frames);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    stats.audioSeconds = wav.frames() / sampleRate;
+    stats.renderSeconds = std::chrono::duration<double>(end - start).count();
+    stats.realTimeFactor = stats.renderSeconds > 0.0 ? stats.audioSeconds / stats.renderSeconds : 0.0;
+    return stats;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cmath>
+
+// Per-voice output meter: peak and RMS of each rendered block.
+//
+// The render loop hands every output sample to operator(), which only
+// stores it. Each OUTPUT_METER_CHUNK samples the chunk is scanned for peak
+// and energy with eight partial results at a time, a loop the compiler
+// vectorizes without -ffast-math. endBlock() publishes the block's peak and
+// RMS, so readers (retirement checks, graphics) see values that change once
+// per block.
+static const int OUTPUT_METER_CHUNK = 64;
+
+class OutputMeter
+{
+private:
+    static const int LANES = 8;
+    static_assert(OUTPUT_METER_CHUNK % LANES == 0, "chunk must be a whole number of lanes");
+
+    alignas(32) float mChunk[OUTPUT_METER_CHUNK];
+    int mFill = 0;
+    float mBlockPeak = 0.0f;
+    float mBlockSum = 0.0f;
+    int mBlockCount = 0;
+    float mPeak = 0.0f;
+    float mRms = 0.0f;
+
+    void flush()
+    {
+        int n = (mFill + LANES - 1) / LANES * LANES;
+        for (int i = mFill; i < n; i++)
+            mChunk[i] = 0.0f; // silence doesn't change peak or energy
+
+        float peak[LANES] = {}, sum[LANES] = {};
+        for (int i = 0; i < n; i += LANES)
+            for (int l = 0; l < LANES; l++)
+            {
+                float s = mChunk[i + l];
+                float a = std::fabs(s);
+                peak[l] = a > peak[l] ? a : peak[l];
+                sum[l] += s * s;
+            }
+        for (int l = 0; l < LANES; l++)
+        {
+            mBlockPeak = peak[l] > mBlockPeak ? peak[l] : mBlockPeak;
+            mBlockSum += sum[l];
+        }
+        mBlockCount += mFill;
+        mFill = 0;
+    }
+
+public:
+    void operator()(float s)
+    {
+        mChunk[mFill++] = s;
+        if (mFill == OUTPUT_METER_CHUNK)
+            flush();
+    }
+
+    // Publish the samples given since the last endBlock()
+    void endBlock()
+    {
+        if (mFill)
+            flush();
+        mPeak = mBlockPeak;
+        mRms = mBlockCount ? std::sqrt(mBlockSum / mBlockCount) : 0.0f;
+        mBlockPeak = mBlockSum = 0.0f;
+        mBlockCount = 0;
+    }
+
+    // Forget everything, e.g. when the voice starts a new note
+    void reset()
+    {
+        mFill = 0;
+        mBlockPeak = mBlockSum = 0.0f;
+        mBlockCount = 0;
+        mPeak = mRms = 0.0f;
+    }
+
+    float peak() const { return mPeak; }
+    float rms() const { return mRms; }
+};
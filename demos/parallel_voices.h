@@ -0,0 +1,123 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_SynthVoice.hpp"
+
+#include "render_pool.h"
+
+// Renders a block's active voices on a RenderPool instead of one after the
+// other on the audio thread.
+//
+// While the voices render (VoicePlayer::render() or PolySynth::render()), a
+// voice's onProcess() calls defer(this, io), which only records the voice
+// and its start offset. onSound() then calls render(io): every deferred
+// voice renders into its own scratch bus on whichever pool thread picks it
+// up, and the buses are summed into io in the order the voices were
+// deferred, so the mix is bit-identical no matter how many threads ran.
+//
+// Voices rendered this way must not touch shared state from their render
+// function beyond reading; calling free() is fine, whoever rendered it
+// picks it up on the next block.
+class ParallelVoices
+{
+public:
+    typedef void (*RenderFunc)(al::SynthVoice *voice, al::AudioIOData &io);
+
+private:
+    struct Job
+    {
+        al::SynthVoice *voice;
+        RenderFunc render;
+        int offset;
+    };
+
+    RenderPool mPool;
+    std::vector<Job> mJobs;
+    std::vector<std::unique_ptr<al::AudioIOData>> mBuses;
+    int mNumJobs = 0;
+    int mFrames = 0;
+    bool mRunning = false;
+
+    template <class Voice>
+    static void renderVoice(al::SynthVoice *voice, al::AudioIOData &io)
+    {
+        static_cast<Voice *>(voice)->renderAudio(io);
+    }
+
+    static void renderJob(void *ctx, int job)
+    {
+        ParallelVoices &self = *static_cast<ParallelVoices *>(ctx);
+        Job &j = self.mJobs[job];
+        al::AudioIOData &bus = *self.mBuses[job];
+        bus.zeroOut();
+        bus.frame(j.offset);
+        j.render(j.voice, bus);
+    }
+
+public:
+    // Start the pool and allocate a stereo scratch bus per voice. Call from
+    // onCreate(); threads <= 1 leaves every voice on the audio thread.
+    void start(int threads, int maxVoices, int framesPerBuffer)
+    {
+        stop();
+        if (threads <= 1)
+            return;
+        mPool.start(threads);
+        mJobs.resize(maxVoices);
+        mBuses.clear();
+        for (int i = 0; i < maxVoices; i++)
+        {
+            mBuses.emplace_back(new al::AudioIOData);
+            mBuses.back()->framesPerBuffer(framesPerBuffer);
+            mBuses.back()->channelsOut(2);
+        }
+        mFrames = framesPerBuffer;
+        mNumJobs = 0;
+        mRunning = true;
+    }
+
+    void stop()
+    {
+        mPool.stop();
+        mRunning = false;
+        mNumJobs = 0;
+    }
+
+    int numThreads() const { return mPool.numThreads(); }
+
+    // Queue voice->renderAudio(io) for render(). Returns false (render it
+    // now) if the pool isn't running or all buses are taken this block.
+    template <class Voice>
+    bool defer(Voice *voice, al::AudioIOData &io)
+    {
+        if (!mRunning || mNumJobs == (int)mJobs.size() || io.framesPerBuffer() > mFrames)
+            return false;
+        // io.frame() is one before the first frame until io() is called
+        mJobs[mNumJobs++] = {voice, &renderVoice<Voice>, io.frame() + 1};
+        return true;
+    }
+
+    // Render everything deferred since the last call and mix it into io
+    void render(al::AudioIOData &io)
+    {
+        if (mNumJobs == 0)
+            return;
+        mPool.run(&renderJob, this, mNumJobs);
+
+        int frames = io.framesPerBuffer();
+        for (int ch = 0; ch < 2; ch++)
+        {
+            float *out = io.outBuffer(ch);
+            for (int job = 0; job < mNumJobs; job++)
+            {
+                const float *in = mBuses[job]->outBuffer(ch);
+                for (int i = 0; i < frames; i++)
+                    out[i] += in[i];
+            }
+        }
+        mNumJobs = 0;
+    }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+
+#include "al/scene/al_SynthVoice.hpp"
+
+// Polyphony caps and voice stealing, on the audio thread.
+//
+// Every note started is add()ed with its instrument and start frame. Before
+// a note starts, makeRoom() steals from its instrument until the
+// instrument's limit and the overall cap leave a free place. The cap
+// follows the CPU budget: callbackLoad() shrinks it in proportion when a
+// callback runs over the budget and lets it grow back a voice per callback
+// once there is headroom. enforce() steals whatever is over the cap, so an
+// overloaded callback drops its quietest notes instead of overrunning.
+//
+// The victim is the quietest note by its current envelope level, the
+// oldest if several are equally quiet. Notes started in the block being
+// rendered haven't sounded yet, so they are only taken (oldest first) when
+// there is nothing else to steal. Levels and stealing are up to the
+// caller, given as functors: level(voice, instrument) and
+// steal(voice, instrument), which should fade the voice out quickly. A
+// stolen voice is forgotten at once, so it no longer counts.
+template <int MAX_VOICES, int NUM_INSTRUMENTS>
+class Polyphony
+{
+private:
+    struct Note
+    {
+        al::SynthVoice *voice;
+        int id;
+        int instrument;
+        uint64_t start;
+    };
+
+    Note mNotes[MAX_VOICES];
+    int mSize = 0;
+    int mCount[NUM_INSTRUMENTS] = {};
+    int mLimit[NUM_INSTRUMENTS];
+    int mCap = MAX_VOICES;
+    int mMinCap = 1;
+    float mMaxLoad = 1.0f;
+    int mStolen = 0;
+
+    void remove(int i)
+    {
+        mCount[mNotes[i].instrument]--;
+        mNotes[i] = mNotes[--mSize];
+    }
+
+    // Index of the note to steal (of instrument, or of any if -1), given
+    // that the block being rendered starts on frame now
+    template <class Level>
+    int victim(int instrument, uint64_t now, Level &level)
+    {
+        int quietest = -1, oldest = -1;
+        float quietestLevel = 0.0f;
+        for (int i = 0; i < mSize; i++)
+        {
+            const Note &n = mNotes[i];
+            if (instrument >= 0 && n.instrument != instrument)
+                continue;
+            if (oldest < 0 || n.start < mNotes[oldest].start)
+                oldest = i;
+            if (n.start >= now)
+                continue;
+            float l = level(n.voice, n.instrument);
+            if (quietest < 0 || l < quietestLevel || (l == quietestLevel && n.start < mNotes[quietest].start))
+            {
+                quietest = i;
+                quietestLevel = l;
+            }
+        }
+        return quietest >= 0 ? quietest : oldest;
+    }
+
+    template <class Steal>
+    void stealNote(int i, Steal &steal)
+    {
+        steal(mNotes[i].voice, mNotes[i].instrument);
+        remove(i);
+        mStolen++;
+    }
+
+public:
+    Polyphony()
+    {
+        for (int i = 0; i < NUM_INSTRUMENTS; i++)
+            mLimit[i] = MAX_VOICES;
+    }
+
+    // Notes instrument may play at once
+    void limit(int instrument, int maxVoices) { mLimit[instrument] = maxVoices; }
+
+    // Keep callbacks under maxLoad of their block's duration, but allow at
+    // least minVoices
+    void budget(float maxLoad, int minVoices)
+    {
+        mMaxLoad = maxLoad;
+        mMinCap = minVoices;
+    }
+
+    int size() const { return mSize; }
+    int cap() const { return mCap; }
+    int stolen() const { return mStolen; }
+
+    // Forget notes whose voice has finished (or been reused for another note)
+    void prune()
+    {
+        for (int i = mSize - 1; i >= 0; i--)
+            if (!mNotes[i].voice->active() || mNotes[i].voice->id() != mNotes[i].id)
+                remove(i);
+    }
+
+    // Steal until instrument can start one more note in the block starting
+    // on frame now
+    template <class Level, class Steal>
+    void makeRoom(int instrument, uint64_t now, Level level, Steal steal)
+    {
+        while (mCount[instrument] > 0 && mCount[instrument] >= mLimit[instrument])
+            stealNote(victim(instrument, now, level), steal);
+        while (mSize > 0 && mSize >= mCap)
+            stealNote(victim(-1, now, level), steal);
+    }
+
+    // Track a note just started; false (and untracked) if the table is full
+    bool add(al::SynthVoice *voice, int id, int instrument, uint64_t start)
+    {
+        if (mSize == MAX_VOICES)
+            return false;
+        mNotes[mSize++] = {voice, id, instrument, start};
+        mCount[instrument]++;
+        return true;
+    }
+
+    // Adjust the cap to load, the last callback's time over its block's
+    // duration
+    void callbackLoad(float load)
+    {
+        if (load > mMaxLoad)
+        {
+            int cap = (int)(mSize * (mMaxLoad / load));
+            cap = cap < mMinCap ? mMinCap : cap;
+            mCap = cap < mCap ? cap : mCap;
+        }
+        else if (load < 0.75f * mMaxLoad && mCap < MAX_VOICES)
+            mCap++;
+    }
+
+    // Steal until no more than cap() notes are playing
+    template <class Level, class Steal>
+    void enforce(uint64_t now, Level level, Steal steal)
+    {
+        while (mSize > mCap)
+            stealNote(victim(-1, now, level), steal);
+    }
+};
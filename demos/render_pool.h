@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Work-stealing thread pool for rendering a block's worth of voices.
+//
+// run() splits numJobs jobs into one contiguous range per thread. Each thread
+// (the caller is thread 0) works through its own range first and then steals
+// what is left of the others, so a few expensive voices don't leave the rest
+// of the threads idle. No locks are taken: ranges are single atomic words,
+// and idle workers spin, then yield, then nap while waiting for the next
+// block.
+//
+// Each range word carries the generation of the run() that filled it, and a
+// thread only claims jobs from ranges of the generation it read func and
+// ctx for. A worker that wakes late can't run a job of the next run() with
+// the previous call's func and ctx, so every run() may pass its own.
+//
+// Jobs must be independent (e.g. each voice renders into its own bus); the
+// caller combines results after run() returns, in job order, so the output
+// doesn't depend on which thread ran which job.
+class RenderPool
+{
+public:
+    typedef void (*JobFunc)(void *ctx, int job);
+    static const int MAX_THREADS = 32;
+    static const int MAX_JOBS = 0xFFFF; // per run() on the pool; more run on the caller
+
+private:
+    // next job (low 16 bits), end of range (next 16) and generation (high
+    // 32) in one word, so a late thread can never pair a new index with an
+    // old end or an old job function
+    struct alignas(64) Range
+    {
+        std::atomic<uint64_t> word{0};
+    };
+
+    Range mRanges[MAX_THREADS];
+    std::vector<std::thread> mThreads;
+    int mNumThreads = 1;
+
+    std::atomic<JobFunc> mFunc{nullptr};
+    std::atomic<void *> mCtx{nullptr};
+    std::atomic<int> mRemaining{0};
+    std::atomic<unsigned> mGeneration{0};
+    std::atomic<bool> mQuit{false};
+
+    static uint64_t pack(uint32_t next, uint32_t end, unsigned gen)
+    {
+        return ((uint64_t)gen << 32) | ((uint64_t)end << 16) | next;
+    }
+
+    // Run jobs of generation gen until none are left. func and ctx are read
+    // after gen, so they are that run()'s: a later run() can't store its
+    // own until every job of gen has been claimed and finished.
+    void work(int self, unsigned gen)
+    {
+        JobFunc func = mFunc.load(std::memory_order_acquire);
+        void *ctx = mCtx.load(std::memory_order_acquire);
+        for (int k = 0; k < mNumThreads; k++)
+        {
+            Range &r = mRanges[(self + k) % mNumThreads];
+            uint64_t v = r.word.load(std::memory_order_acquire);
+            for (;;)
+            {
+                uint32_t job = (uint32_t)v & 0xFFFF, end = (uint32_t)(v >> 16) & 0xFFFF;
+                if ((unsigned)(v >> 32) != gen || job >= end)
+                    break;
+                // claim by compare-exchange, so a stale thread never moves
+                // a newer generation's range
+                if (!r.word.compare_exchange_weak(v, v + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+                    continue;
+                func(ctx, (int)job);
+                mRemaining.fetch_sub(1, std::memory_order_release);
+                v = r.word.load(std::memory_order_acquire);
+            }
+        }
+    }
+
+    void workerLoop(int self)
+    {
+        unsigned seen = mGeneration.load(std::memory_order_acquire);
+        int idle = 0;
+        while (!mQuit.load(std::memory_order_relaxed))
+        {
+            unsigned gen = mGeneration.load(std::memory_order_acquire);
+            if (gen != seen)
+            {
+                seen = gen;
+                idle = 0;
+                work(self, gen);
+                continue;
+            }
+            // spin briefly, then yield, then nap so an idle pool costs little
+            if (++idle < 2000)
+                continue;
+            if (idle < 20000)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    static void pin(std::thread &t, int cpu)
+    {
+#ifdef __linux__
+        int cpus = (int)std::thread::hardware_concurrency(); // 0 if unknown
+        if (cpus <= 0)
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % cpus, &set);
+        pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#else
+        (void)t;
+        (void)cpu;
+#endif
+    }
+
+public:
+    ~RenderPool() { stop(); }
+
+    // Start numThreads - 1 workers (the thread calling run() is the other
+    // one), optionally pinning worker i to cpu i. Not real-time safe.
+    void start(int numThreads, bool pinThreads = true)
+    {
+        stop();
+        if (numThreads < 1)
+            numThreads = 1;
+        if (numThreads > MAX_THREADS)
+            numThreads = MAX_THREADS;
+        mNumThreads = numThreads;
+        mQuit = false;
+        for (int i = 1; i < numThreads; i++)
+        {
+            mThreads.emplace_back(&RenderPool::workerLoop, this, i);
+            if (pinThreads)
+                pin(mThreads.back(), i);
+        }
+    }
+
+    void stop()
+    {
+        mQuit = true;
+        for (std::thread &t : mThreads)
+            t.join();
+        mThreads.clear();
+        mNumThreads = 1;
+    }
+
+    int numThreads() const { return mNumThreads; }
+
+    // Run func(ctx, job) for job = 0 .. numJobs - 1 and wait for all of
+    // them. Each call may pass a different func and ctx.
+    void run(JobFunc func, void *ctx, int numJobs)
+    {
+        if (numJobs <= 0)
+            return;
+        if (mNumThreads == 1 || numJobs == 1 || numJobs > MAX_JOBS)
+        {
+            for (int job = 0; job < numJobs; job++)
+                func(ctx, job);
+            return;
+        }
+
+        unsigned gen = mGeneration.load(std::memory_order_relaxed) + 1;
+        mFunc.store(func, std::memory_order_release);
+        mCtx.store(ctx, std::memory_order_release);
+        mRemaining.store(numJobs, std::memory_order_release);
+        for (int t = 0; t < mNumThreads; t++)
+        {
+            uint32_t begin = (uint32_t)((int64_t)numJobs * t / mNumThreads);
+            uint32_t end = (uint32_t)((int64_t)numJobs * (t + 1) / mNumThreads);
+            mRanges[t].word.store(pack(begin, end, gen), std::memory_order_release);
+        }
+        mGeneration.store(gen, std::memory_order_release);
+
+        work(0, gen);
+        while (mRemaining.load(std::memory_order_acquire) > 0)
+            ;
+    }
+};
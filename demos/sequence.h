@@ -0,0 +1,547 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+class TimeSignature
+{
+private:
+    int upper;
+    int lower;
+
+public:
+    TimeSignature()
+    {
+        this->upper = 7;
+        this->lower = 4;
+    }
+};
+
+class Note
+{
+private:
+    float freq;
+    float time;
+    float duration;
+    float amp;
+    float attack;
+    float decay;
+
+public:
+    constexpr Note() : freq(440.0f), time(0.0f), duration(0.5f), amp(0.2f), attack(0.05f), decay(0.05f) {}
+    constexpr Note(float freq,
+                   float time = 0.0f,
+                   float duration = 0.5f,
+                   float amp = 0.2f,
+                   float attack = 0.05f,
+                   float decay = 0.05f)
+        : freq(freq), time(time), duration(duration), amp(amp), attack(attack), decay(decay)
+    {
+    }
+    // Return an identical note, but offset by the
+    // number of beats indicated by beatOffset,
+    // and with amplitude multiplied by ampMult
+    constexpr Note(const Note &n, float beatOffset, float ampMult = 1.0f)
+        : freq(n.freq), time(n.time + beatOffset), duration(n.duration), amp(n.amp * ampMult), attack(n.attack),
+          decay(n.decay)
+    {
+    }
+    float getFreq() { return this->freq; }
+    float getTime() { return this->time; }
+    float getDuration() { return this->duration; }
+    float getAmp() { return this->amp; }
+    float getAttack() { return this->attack; }
+    float getDecay() { return this->decay; }
+};
+
+// Bump allocator for sequence storage.
+//
+// Sequences and their note arrays are carved out of large chunks that are
+// only given back all at once (reset() or destruction), so building a
+// phrase costs a pointer bump per allocation and nothing is leaked.
+class SequenceArena
+{
+private:
+    std::vector<std::unique_ptr<char[]>> mChunks;
+    size_t mChunkSize;
+    size_t mSize; // size of the last chunk
+    size_t mUsed; // bytes used in the last chunk
+    size_t mTotal;
+
+    // offset of the first address at or after chunk + used aligned to align
+    static size_t alignUp(char *chunk, size_t used, size_t align)
+    {
+        uintptr_t p = (uintptr_t)(chunk + used);
+        return used + (((p + align - 1) & ~(uintptr_t)(align - 1)) - p);
+    }
+
+public:
+    SequenceArena(size_t chunkSize = 64 * 1024)
+    {
+        mChunkSize = chunkSize;
+        mSize = 0;
+        mUsed = 0;
+        mTotal = 0;
+    }
+
+    void *allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    {
+        char *chunk = mChunks.empty() ? nullptr : mChunks.back().get();
+        size_t start = alignUp(chunk, mUsed, align);
+        if (!chunk || start + bytes > mSize)
+        {
+            mSize = bytes + align > mChunkSize ? bytes + align : mChunkSize;
+            mChunks.emplace_back(new char[mSize]);
+            mTotal += mSize;
+            chunk = mChunks.back().get();
+            start = alignUp(chunk, 0, align);
+        }
+        mUsed = start + bytes;
+        return chunk + start;
+    }
+
+    template <class T, class... Args>
+    T *make(Args &&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(static_cast<Args &&>(args)...);
+    }
+
+    // Bytes reserved from the system so far
+    size_t bytesReserved() const { return mTotal; }
+
+    // Give back everything. Every Sequence made from this arena is invalid
+    // afterwards. Objects in the arena are not destroyed, so only put
+    // trivially destructible things in it.
+    void reset()
+    {
+        mChunks.clear();
+        mSize = 0;
+        mUsed = 0;
+        mTotal = 0;
+    }
+};
+
+// Structure-of-arrays note storage.
+//
+// Each note field lives in its own contiguous array (all six carved out of
+// one arena block), so the bulk operations below are plain loops over
+// floats that the compiler vectorizes, and appending a phrase is a handful
+// of memcpys.
+class NoteStore
+{
+private:
+    SequenceArena *mArena;
+    int mSize = 0;
+    int mCapacity = 0;
+
+public:
+    float *freq = nullptr;
+    float *time = nullptr; // beats
+    float *duration = nullptr; // beats
+    float *amp = nullptr;
+    float *attack = nullptr;
+    float *decay = nullptr;
+
+    NoteStore(SequenceArena *arena) : mArena(arena) {}
+
+    int size() const { return mSize; }
+
+    // Make room for n notes in total. Outgrown arrays stay in the arena
+    // until it is reset, so size stores up front where possible.
+    void reserve(int n)
+    {
+        if (n <= mCapacity)
+            return;
+        n = (n + 15) & ~15; // keep every array 64-byte aligned
+        float *block = static_cast<float *>(mArena->allocate(6 * n * sizeof(float), 64));
+        float **fields[6] = {&freq, &time, &duration, &amp, &attack, &decay};
+        for (int f = 0; f < 6; f++)
+        {
+            if (mSize)
+                std::memcpy(block + f * n, *fields[f], mSize * sizeof(float));
+            *fields[f] = block + f * n;
+        }
+        mCapacity = n;
+    }
+
+    void add(Note n)
+    {
+        if (mSize == mCapacity)
+            reserve(mCapacity ? mCapacity * 2 : 16);
+        freq[mSize] = n.getFreq();
+        time[mSize] = n.getTime();
+        duration[mSize] = n.getDuration();
+        amp[mSize] = n.getAmp();
+        attack[mSize] = n.getAttack();
+        decay[mSize] = n.getDecay();
+        mSize++;
+    }
+
+    Note get(int i) const { return Note(freq[i], time[i], duration[i], amp[i], attack[i], decay[i]); }
+
+    // Append all of src, moved by beatOffset beats and scaled by ampMult
+    void append(const NoteStore &src, float beatOffset = 0.0f, float ampMult = 1.0f)
+    {
+        if (mSize + src.mSize > mCapacity)
+            reserve(std::max(mSize + src.mSize, mCapacity * 2)); // double, or repeated appends go quadratic
+        int n = src.mSize, at = mSize;
+        std::memcpy(freq + at, src.freq, n * sizeof(float));
+        std::memcpy(time + at, src.time, n * sizeof(float));
+        std::memcpy(duration + at, src.duration, n * sizeof(float));
+        std::memcpy(amp + at, src.amp, n * sizeof(float));
+        std::memcpy(attack + at, src.attack, n * sizeof(float));
+        std::memcpy(decay + at, src.decay, n * sizeof(float));
+        mSize += n;
+        offsetTime(beatOffset, at);
+        scaleAmp(ampMult, at);
+    }
+
+    // Bulk edits of notes first .. size() - 1
+
+    void transpose(float ratio, int first = 0)
+    {
+        float *__restrict f = freq;
+        for (int i = first; i < mSize; i++)
+            f[i] *= ratio;
+    }
+
+    void offsetTime(float beats, int first = 0)
+    {
+        if (beats == 0.0f)
+            return;
+        float *__restrict t = time;
+        for (int i = first; i < mSize; i++)
+            t[i] += beats;
+    }
+
+    void scaleAmp(float mult, int first = 0)
+    {
+        if (mult == 1.0f)
+            return;
+        float *__restrict a = amp;
+        for (int i = first; i < mSize; i++)
+            a[i] *= mult;
+    }
+
+    // Write note start times and durations in seconds at bpm
+    void beatsToSeconds(float bpm, float *__restrict timeOut, float *__restrict durationOut) const
+    {
+        float secondsPerBeat = 60.0f / bpm;
+        const float *__restrict t = time;
+        const float *__restrict d = duration;
+        for (int i = 0; i < mSize; i++)
+        {
+            timeOut[i] = t[i] * secondsPerBeat;
+            durationOut[i] = d[i] * secondsPerBeat;
+        }
+    }
+
+    // Beat at which the last note ends
+    float endBeat() const
+    {
+        float end = 0.0f;
+        for (int i = 0; i < mSize; i++)
+            end = time[i] + duration[i] > end ? time[i] + duration[i] : end;
+        return end;
+    }
+};
+
+class Sequence;
+
+// A phrase played inside another sequence without copying its notes: the
+// notes of sequence, moved to startBeat, amplitudes times ampMult, played
+// repeats times every `every` beats. Parts live in the owning sequence's
+// arena and are chained through next.
+struct SequencePart
+{
+    Sequence *sequence;
+    float startBeat;
+    float ampMult;
+    int repeats;
+    float every;
+    SequencePart *next;
+};
+
+// A sequence is an arrangement tree: notes of its own plus parts that play
+// other sequences (see addPhrase()). NoteStream walks the tree lazily, so a
+// song of many repeats costs no more to build or hold than its phrases.
+class Sequence
+{
+private:
+    TimeSignature ts;
+    NoteStore notes;
+    SequenceArena *mArena;
+    SequencePart *mParts = nullptr;
+    SequencePart *mLastPart = nullptr;
+    int *mOrder = nullptr; // own notes by start time, built by order()
+
+public:
+    Sequence(TimeSignature ts, SequenceArena *arena) : notes(arena), mArena(arena)
+    {
+        this->ts = ts;
+    }
+
+    void reserve(int n) { notes.reserve(n); }
+
+    void add(Note n)
+    {
+        notes.add(n);
+        mOrder = nullptr;
+    }
+
+    // Add notes from the source sequence s,
+    // but starting on the beat indicated by startBeat
+    // (copies s's own notes now; its parts are not copied, see addPhrase())
+
+    void addSequence(Sequence *s, float startBeat, float ampMult = 1.0)
+    {
+        notes.append(s->notes, startBeat, ampMult);
+        mOrder = nullptr;
+    }
+
+    // Play s from startBeat with amplitudes times ampMult, repeats times,
+    // every `every` beats (by default s's length) apart. Nothing is copied:
+    // s is played as it is when the sequence is streamed, so it must outlive
+    // this one and must not contain it.
+    void addPhrase(Sequence *s, float startBeat, float ampMult = 1.0f, int repeats = 1, float every = 0.0f)
+    {
+        SequencePart *p = mArena->make<SequencePart>();
+        *p = {s, startBeat, ampMult, repeats, every > 0.0f ? every : s->endBeat(), nullptr};
+        if (mLastPart)
+            mLastPart->next = p;
+        else
+            mParts = p;
+        mLastPart = p;
+    }
+
+    // Own notes only; parts aren't counted (see noteCount())
+    int size() const { return notes.size(); }
+
+    // Own notes, for editing in place
+    NoteStore &getNotes()
+    {
+        mOrder = nullptr; // the caller may move notes
+        return notes;
+    }
+    const NoteStore &ownNotes() const { return notes; }
+    const SequencePart *parts() const { return mParts; }
+
+    // Indices of the own notes in start time order (ties in the order they
+    // were added), kept in the arena until the notes change
+    const int *order()
+    {
+        if (!mOrder && notes.size())
+        {
+            int n = notes.size();
+            mOrder = static_cast<int *>(mArena->allocate(n * sizeof(int), alignof(int)));
+            for (int i = 0; i < n; i++)
+                mOrder[i] = i;
+            const float *time = notes.time;
+            std::stable_sort(mOrder, mOrder + n, [time](int a, int b) { return time[a] < time[b]; });
+        }
+        return mOrder;
+    }
+
+    // Beat of the first note, own or in a part; INFINITY if there is none
+    float firstBeat()
+    {
+        float first = notes.size() ? notes.time[order()[0]] : INFINITY;
+        for (SequencePart *p = mParts; p; p = p->next)
+            if (p->repeats > 0)
+                first = std::min(first, p->startBeat + p->sequence->firstBeat());
+        return first;
+    }
+
+    // Beat at which the last note ends, own or in a part
+    float endBeat()
+    {
+        float end = notes.endBeat();
+        for (SequencePart *p = mParts; p; p = p->next)
+            if (p->repeats > 0)
+                end = std::max(end, p->startBeat + (p->repeats - 1) * p->every + p->sequence->endBeat());
+        return end;
+    }
+
+    // Notes played in all, counting every part and repeat
+    long noteCount()
+    {
+        long count = notes.size();
+        for (SequencePart *p = mParts; p; p = p->next)
+            if (p->repeats > 0)
+                count += p->repeats * p->sequence->noteCount();
+        return count;
+    }
+};
+
+// Notes of a Sequence tree in start time order, produced on demand.
+//
+// A k-way merge: a min-heap holds one cursor per phrase instance that is
+// sounding or about to, keyed on the beat of its next note. A part
+// repetition is expanded into its phrase's cursors only when its first
+// note comes due, and schedules the repetition after it at the same
+// moment, so the heap holds as many cursors as phrases overlap at once,
+// however many repeats the song has. Memory is that heap alone, kept
+// inside the stream for up to NOTE_STREAM_CURSORS cursors, so making and
+// playing a stream doesn't allocate unless the tree is unusually deep.
+static const int NOTE_STREAM_CURSORS = 32;
+
+class NoteStream
+{
+private:
+    struct Cursor
+    {
+        float beat; // of the next note, the heap key
+        uint32_t order; // ties go to the cursor made first
+        Sequence *sequence;
+        const SequencePart *part; // a repetition of part to expand, or null
+        int index; // next own note of sequence (in order()), if part is null
+        int rep;
+        float offset; // beats and amplitude applied by the enclosing parts
+        float ampMult;
+    };
+
+    Cursor mCursors[NOTE_STREAM_CURSORS];
+    std::vector<Cursor> mSpill; // all the cursors, once there are too many
+    int mSize = 0;
+    uint32_t mMade = 0;
+
+    Cursor *heap() { return mSpill.empty() ? mCursors : mSpill.data(); }
+
+    static bool later(const Cursor &a, const Cursor &b)
+    {
+        return a.beat > b.beat || (a.beat == b.beat && a.order > b.order);
+    }
+
+    void push(Cursor c)
+    {
+        c.order = mMade++;
+        if (mSize == NOTE_STREAM_CURSORS && mSpill.empty())
+            mSpill.assign(mCursors, mCursors + mSize);
+        if (!mSpill.empty())
+            mSpill.resize(mSize + 1);
+        heap()[mSize++] = c;
+        std::push_heap(heap(), heap() + mSize, later);
+    }
+
+    // Start playing sequence at offset: a cursor for its own notes and one
+    // for the first repetition of each part
+    void expand(Sequence *sequence, float offset, float ampMult)
+    {
+        if (sequence->size())
+            push({offset + sequence->ownNotes().time[sequence->order()[0]], 0, sequence, nullptr, 0, 0, offset, ampMult});
+        for (const SequencePart *p = sequence->parts(); p; p = p->next)
+            pushRepetition(p, 0, offset, ampMult);
+    }
+
+    void pushRepetition(const SequencePart *p, int rep, float offset, float ampMult)
+    {
+        if (rep >= p->repeats)
+            return;
+        float first = p->sequence->firstBeat();
+        if (first == INFINITY)
+            return; // nothing to play
+        push({offset + p->startBeat + rep * p->every + first, 0, p->sequence, p, 0, rep, offset, ampMult});
+    }
+
+    // Expand part repetitions until a note cursor is on top
+    void settle()
+    {
+        while (mSize > 0 && heap()[0].part)
+        {
+            std::pop_heap(heap(), heap() + mSize, later);
+            Cursor c = heap()[--mSize];
+            pushRepetition(c.part, c.rep + 1, c.offset, c.ampMult);
+            expand(c.sequence, c.offset + c.part->startBeat + c.rep * c.part->every, c.ampMult * c.part->ampMult);
+        }
+    }
+
+public:
+    // Stream root's notes moved by beatOffset and scaled by ampMult
+    NoteStream(Sequence *root, float beatOffset = 0.0f, float ampMult = 1.0f)
+    {
+        expand(root, beatOffset, ampMult);
+    }
+
+    // Beat of the next note, INFINITY once the stream has ended
+    float peekBeat()
+    {
+        settle();
+        return mSize == 0 ? INFINITY : heap()[0].beat;
+    }
+
+    // Take the next note into n; false once the stream has ended
+    bool next(Note &n)
+    {
+        settle();
+        if (mSize == 0)
+            return false;
+        std::pop_heap(heap(), heap() + mSize, later);
+        Cursor &c = heap()[mSize - 1];
+        const NoteStore &notes = c.sequence->ownNotes();
+        int i = c.sequence->order()[c.index];
+        n = Note(notes.freq[i], c.offset + notes.time[i], notes.duration[i], notes.amp[i] * c.ampMult,
+                 notes.attack[i], notes.decay[i]);
+        if (++c.index < notes.size())
+        {
+            c.beat = c.offset + notes.time[c.sequence->order()[c.index]];
+            std::push_heap(heap(), heap() + mSize, later);
+        }
+        else
+            mSize--;
+        return true;
+    }
+};
+
+// Phrases built once and reused by handle.
+//
+// A phrase builder asks find() first and only builds (with create()) on a
+// miss, so playing a song again schedules straight from the cached
+// sequences without allocating. Handles are small ints chosen by the
+// caller; arg distinguishes variants of one phrase, e.g. a transposition.
+class PhraseCache
+{
+private:
+    struct Entry
+    {
+        int handle;
+        float arg;
+        Sequence *sequence;
+    };
+
+    SequenceArena mArena;
+    std::vector<Entry> mEntries;
+
+public:
+    Sequence *find(int handle, float arg = 1.0f)
+    {
+        for (Entry &e : mEntries)
+            if (e.handle == handle && e.arg == arg)
+                return e.sequence;
+        return nullptr;
+    }
+
+    // Make an empty sequence in the cache's arena and file it under
+    // handle/arg; the caller fills it in
+    Sequence *create(int handle, float arg = 1.0f, TimeSignature ts = TimeSignature())
+    {
+        Sequence *s = mArena.make<Sequence>(ts, &mArena);
+        mEntries.push_back({handle, arg, s});
+        return s;
+    }
+
+    size_t bytesReserved() const { return mArena.bytesReserved(); }
+
+    // Drop every phrase (e.g. after editing a builder); sequences returned
+    // earlier are invalid afterwards
+    void clear()
+    {
+        mEntries.clear();
+        mArena.reset();
+    }
+};
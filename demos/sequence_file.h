@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sequence.h"
+
+// Binary sequence files (.gseq).
+//
+// A fixed 288-byte header is followed by numNotes packed 32-byte note
+// records, so a file is memory-mapped and scheduled in place, with no
+// copy or parse. Opening one only reads the records once to check their
+// times are numbers. Records refer to instruments by index into the
+// header's name table, so a file can be played by any demo that knows
+// those instrument names. Times are in beats; bpm is only the tempo the
+// file suggests. All fields are little-endian.
+//
+// writeSequenceFile() stores the records in time order and says so in the
+// header's flags, along with the beat the last note ends on, so a player
+// neither sorts nor scans the file. Files without those flags (written
+// before they existed) are scanned for both when opened.
+
+static const char SEQUENCE_FILE_MAGIC[4] = {'G', 'S', 'E', 'Q'};
+static const uint32_t SEQUENCE_FILE_VERSION = 1;
+static const int SEQUENCE_FILE_MAX_INSTRUMENTS = 16;
+static const int SEQUENCE_FILE_NAME_LENGTH = 16;
+
+// SequenceFileHeader::flags: the records are in time order; endBeat is set
+static const uint32_t SEQUENCE_FILE_SORTED = 1;
+static const uint32_t SEQUENCE_FILE_END_BEAT = 2;
+
+struct SequenceFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t headerBytes; // offset of the first note record
+    uint32_t numNotes;
+    float bpm;
+    uint32_t numInstruments;
+    uint32_t flags; // SEQUENCE_FILE_SORTED, SEQUENCE_FILE_END_BEAT
+    float endBeat;  // where the last note ends, in beats
+    char instruments[SEQUENCE_FILE_MAX_INSTRUMENTS][SEQUENCE_FILE_NAME_LENGTH]; // zero padded
+};
+
+struct PackedNote
+{
+    float time;     // beats
+    float duration; // beats
+    float freq;
+    float amp;
+    float attack;
+    float decay;
+    uint32_t instrument; // index into SequenceFileHeader::instruments
+    uint32_t reserved;
+};
+
+static_assert(sizeof(SequenceFileHeader) == 288, "sequence file header layout");
+static_assert(sizeof(PackedNote) == 32, "sequence file note layout");
+
+// Append every note of s (its phrases expanded), played on instrument, to out
+inline void packSequence(Sequence &s, uint32_t instrument, std::vector<PackedNote> &out)
+{
+    NoteStream notes(&s);
+    Note n;
+    while (notes.next(n))
+        out.push_back({n.getTime(), n.getDuration(), n.getFreq(), n.getAmp(), n.getAttack(), n.getDecay(), instrument, 0});
+}
+
+// Write notes, in any order, as a .gseq file; they are stored sorted by
+// time, notes starting together kept in the order given
+inline bool writeSequenceFile(const char *path, const PackedNote *notes, int numNotes, float bpm,
+                              const char *const *instrumentNames, int numInstruments)
+{
+    if (numInstruments > SEQUENCE_FILE_MAX_INSTRUMENTS)
+        return false;
+
+    std::vector<PackedNote> sorted(notes, notes + numNotes);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const PackedNote &a, const PackedNote &b) { return a.time < b.time; });
+    float endBeat = 0.0f;
+    for (const PackedNote &n : sorted)
+        endBeat = std::max(endBeat, n.time + n.duration);
+
+    SequenceFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SEQUENCE_FILE_MAGIC, 4);
+    header.version = SEQUENCE_FILE_VERSION;
+    header.headerBytes = sizeof(header);
+    header.numNotes = (uint32_t)numNotes;
+    header.bpm = bpm;
+    header.numInstruments = (uint32_t)numInstruments;
+    header.flags = SEQUENCE_FILE_SORTED | SEQUENCE_FILE_END_BEAT;
+    header.endBeat = endBeat;
+    for (int i = 0; i < numInstruments; i++)
+        std::strncpy(header.instruments[i], instrumentNames[i], SEQUENCE_FILE_NAME_LENGTH - 1);
+
+    std::FILE *f = std::fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+              (numNotes == 0 || std::fwrite(sorted.data(), sizeof(PackedNote), numNotes, f) == (size_t)numNotes);
+    return std::fclose(f) == 0 && ok;
+}
+
+// A read-only view of a .gseq file, mapped into memory
+class MappedSequence
+{
+private:
+    const char *mData = nullptr;
+    size_t mBytes = 0;
+#ifdef _WIN32
+    std::vector<char> mCopy; // no mmap here: read the file instead
+#endif
+    bool mSorted = false;
+    float mEndBeat = 0.0f;
+
+    bool valid() const
+    {
+        if (mBytes < sizeof(SequenceFileHeader))
+            return false;
+        const SequenceFileHeader &h = header();
+        for (int i = 0; i < SEQUENCE_FILE_MAX_INSTRUMENTS; i++)
+            if (!std::memchr(h.instruments[i], 0, SEQUENCE_FILE_NAME_LENGTH))
+                return false;
+        return std::memcmp(h.magic, SEQUENCE_FILE_MAGIC, 4) == 0 && h.version == SEQUENCE_FILE_VERSION &&
+               h.headerBytes >= sizeof(SequenceFileHeader) && h.headerBytes <= mBytes &&
+               h.headerBytes % alignof(PackedNote) == 0 &&
+               h.numInstruments <= (uint32_t)SEQUENCE_FILE_MAX_INSTRUMENTS &&
+               (mBytes - h.headerBytes) / sizeof(PackedNote) >= h.numNotes && h.bpm > 0.0f &&
+               std::isfinite(h.bpm) && std::isfinite(h.endBeat);
+    }
+
+    // Check every note's time and duration are numbers, and find out
+    // whether the notes are sorted and where they end if the header
+    // doesn't say
+    bool scanNotes()
+    {
+        const SequenceFileHeader &h = header();
+        const PackedNote *n = notes();
+        bool sorted = true;
+        float endBeat = 0.0f;
+        for (int i = 0; i < size(); i++)
+        {
+            if (!std::isfinite(n[i].time) || !std::isfinite(n[i].duration))
+                return false;
+            if (i > 0 && n[i].time < n[i - 1].time)
+                sorted = false;
+            endBeat = std::max(endBeat, n[i].time + n[i].duration);
+        }
+        mSorted = (h.flags & SEQUENCE_FILE_SORTED) ? true : sorted;
+        mEndBeat = (h.flags & SEQUENCE_FILE_END_BEAT) ? h.endBeat : endBeat;
+        return true;
+    }
+
+public:
+    MappedSequence() {}
+    MappedSequence(const MappedSequence &) = delete;
+    MappedSequence &operator=(const MappedSequence &) = delete;
+    ~MappedSequence() { close(); }
+
+    // Map path. Returns false if it can't be read or isn't a sequence file.
+    bool open(const char *path)
+    {
+        close();
+#ifdef _WIN32
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            return false;
+        mCopy.resize((size_t)in.tellg());
+        in.seekg(0);
+        in.read(mCopy.data(), mCopy.size());
+        mData = mCopy.data();
+        mBytes = mCopy.size();
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                mData = static_cast<const char *>(p);
+                mBytes = (size_t)st.st_size;
+            }
+        }
+        ::close(fd);
+#endif
+        if (!valid() || !scanNotes())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        mCopy.clear();
+#else
+        if (mData)
+            munmap(const_cast<char *>(mData), mBytes);
+#endif
+        mData = nullptr;
+        mBytes = 0;
+    }
+
+    bool isOpen() const { return mData != nullptr; }
+    const SequenceFileHeader &header() const { return *reinterpret_cast<const SequenceFileHeader *>(mData); }
+    int size() const { return (int)header().numNotes; }
+    float bpm() const { return header().bpm; }
+    // Whether the notes are in time order, and the beat the last one ends on
+    bool sorted() const { return mSorted; }
+    float endBeat() const { return mEndBeat; }
+    const PackedNote *notes() const { return reinterpret_cast<const PackedNote *>(mData + header().headerBytes); }
+    const PackedNote &operator[](int i) const { return notes()[i]; }
+
+    int numInstruments() const { return (int)header().numInstruments; }
+    // Instrument name i, or "" if i is out of range
+    const char *instrumentName(int i) const
+    {
+        static const char none[SEQUENCE_FILE_NAME_LENGTH] = {0};
+        return i >= 0 && i < numInstruments() ? header().instruments[i] : none;
+    }
+};
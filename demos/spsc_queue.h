@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Wait-free single-producer / single-consumer ring buffer.
+//
+// One thread (e.g. the GUI) calls push(), one other thread (the audio
+// callback) calls pop(). Neither ever blocks or allocates: push() fails when
+// the ring is full and pop() fails when it is empty. CAPACITY must be a
+// power of two; items are copied in and out, so keep T small and trivially
+// copyable.
+template <class T, int CAPACITY>
+class SpscQueue
+{
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+private:
+    static const uint32_t MASK = CAPACITY - 1;
+
+    // head is only written by the consumer and tail by the producer; keep
+    // them on separate cache lines so the two threads don't false-share
+    alignas(64) std::atomic<uint32_t> mHead{0};
+    alignas(64) std::atomic<uint32_t> mTail{0};
+    alignas(64) T mItems[CAPACITY];
+
+public:
+    // Producer: add item, or return false if the ring is full
+    bool push(const T &item)
+    {
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == (uint32_t)CAPACITY)
+            return false;
+        mItems[tail & MASK] = item;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: take the oldest item, or return false if there is none
+    bool pop(T &item)
+    {
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+            return false;
+        item = mItems[head & MASK];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of items waiting; exact only when called from one of the two
+    // threads while the other is idle
+    int size() const { return (int)(mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire)); }
+
+    static int capacity() { return CAPACITY; }
+};
@@ -0,0 +1,141 @@
+// Converts between binary .gseq sequence files and text.
+//
+// The text side uses the note lines of allolib's .synthSequence format, with
+// the instrument name in place of the synth name and the note's own fields
+// as parameters:
+//
+//   @ <start sec> <duration sec> <instrument> <amplitude> <frequency> [<attack> <decay>]
+//
+// Text times are in seconds, .gseq times in beats. A "# bpm <n>" line sets
+// the tempo used to convert (60 by default, so seconds equal beats), and is
+// written back out when converting to text.
+//
+// usage: sequence_convert in.synthSequence out.gseq
+//        sequence_convert in.gseq out.synthSequence
+//
+// build: g++ -O2 -std=c++17 sequence_convert.cpp -o sequence_convert
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../sequence_file.h"
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static int textToBinary(const char *inPath, const char *outPath)
+{
+    std::FILE *in = std::fopen(inPath, "r");
+    if (!in)
+    {
+        std::fprintf(stderr, "can't read %s\n", inPath);
+        return 1;
+    }
+
+    float bpm = 60.0f;
+    std::vector<PackedNote> notes;
+    std::vector<std::string> names;
+    char line[1024];
+    int lineNumber = 0;
+    while (std::fgets(line, sizeof(line), in))
+    {
+        lineNumber++;
+        float value;
+        if (std::sscanf(line, " # bpm %f", &value) == 1 && value > 0.0f && std::isfinite(value))
+        {
+            bpm = value;
+            continue;
+        }
+
+        float start, duration, amp, freq, attack = 0.05f, decay = 0.05f;
+        char name[64];
+        int fields = std::sscanf(line, " @ %f %f %63s %f %f %f %f", &start, &duration, name, &amp, &freq, &attack, &decay);
+        if (fields < 1)
+            continue; // blank line, comment or an event type we don't use
+        if (fields < 5)
+        {
+            std::fprintf(stderr, "%s:%d: expected @ start duration instrument amplitude frequency\n", inPath, lineNumber);
+            continue;
+        }
+
+        if (!std::isfinite(start) || !std::isfinite(duration))
+        {
+            std::fprintf(stderr, "%s:%d: start and duration must be numbers\n", inPath, lineNumber);
+            continue;
+        }
+
+        uint32_t instrument = 0;
+        while (instrument < names.size() && names[instrument] != name)
+            instrument++;
+        if (instrument == names.size())
+        {
+            if (names.size() == (size_t)SEQUENCE_FILE_MAX_INSTRUMENTS || std::strlen(name) >= (size_t)SEQUENCE_FILE_NAME_LENGTH)
+            {
+                std::fprintf(stderr, "%s:%d: can't add instrument %s\n", inPath, lineNumber, name);
+                continue;
+            }
+            names.push_back(name);
+        }
+
+        float beatsPerSecond = bpm / 60.0f;
+        notes.push_back({start * beatsPerSecond, duration * beatsPerSecond, freq, amp, attack, decay, instrument, 0});
+    }
+    std::fclose(in);
+
+    std::vector<const char *> nameTable;
+    for (const std::string &n : names)
+        nameTable.push_back(n.c_str());
+    if (!writeSequenceFile(outPath, notes.data(), (int)notes.size(), bpm, nameTable.data(), (int)nameTable.size()))
+    {
+        std::fprintf(stderr, "can't write %s\n", outPath);
+        return 1;
+    }
+    std::printf("%s: %zu notes, %zu instruments, %g bpm\n", outPath, notes.size(), names.size(), bpm);
+    return 0;
+}
+
+static int binaryToText(const char *inPath, const char *outPath)
+{
+    MappedSequence seq;
+    if (!seq.open(inPath))
+    {
+        std::fprintf(stderr, "%s is not a sequence file\n", inPath);
+        return 1;
+    }
+    std::FILE *out = std::fopen(outPath, "w");
+    if (!out)
+    {
+        std::fprintf(stderr, "can't write %s\n", outPath);
+        return 1;
+    }
+
+    float secondsPerBeat = 60.0f / seq.bpm();
+    std::fprintf(out, "# bpm %g\n", seq.bpm());
+    for (int i = 0; i < seq.size(); i++)
+    {
+        const PackedNote &n = seq[i];
+        std::fprintf(out, "@ %g %g %s %g %g %g %g\n", n.time * secondsPerBeat, n.duration * secondsPerBeat,
+                     seq.instrumentName((int)n.instrument), n.amp, n.freq, n.attack, n.decay);
+    }
+    std::fclose(out);
+    std::printf("%s: %d notes\n", outPath, seq.size());
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "usage: %s in.synthSequence out.gseq | in.gseq out.synthSequence\n", argv[0]);
+        return 2;
+    }
+    if (endsWith(argv[1], ".gseq"))
+        return binaryToText(argv[1], argv[2]);
+    return textToBinary(argv[1], argv[2]);
+}
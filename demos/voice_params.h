@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "al/ui/al_Parameter.hpp"
+
+// Cached handles from a voice's internal trigger parameters to the fields of
+// a plain parameter block struct.
+//
+// getInternalParameterValue("name") looks the parameter up by string every
+// call. Instead, bind each parameter once in init() and pull() the whole
+// block at the top of the render loop; the loop then reads plain floats.
+//
+//   struct MyParams { float amplitude = 0.3f; float frequency = 60; };
+//   ParamHandles<MyParams> mHandles;
+//   MyParams mParams;
+//
+//   mHandles.bind(&MyParams::amplitude,
+//                 createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0));
+//   ...
+//   mHandles.pull(mParams);
+template <class Block>
+class ParamHandles
+{
+private:
+    struct Handle
+    {
+        al::Parameter *param;
+        float Block::*field;
+    };
+    std::vector<Handle> mHandles;
+
+public:
+    // Call from init() only: may allocate
+    void bind(float Block::*field, al::Parameter &param)
+    {
+        mHandles.push_back({&param, field});
+    }
+
+    // Copy current parameter values into the block. No lookups or allocation.
+    void pull(Block &block) const
+    {
+        for (const Handle &h : mHandles)
+            block.*h.field = h.param->get();
+    }
+
+    // Write the block back out to the parameters, e.g. so the GUI and
+    // recorder see values that were set directly on the block
+    void push(const Block &block) const
+    {
+        for (const Handle &h : mHandles)
+            h.param->set(block.*h.field);
+    }
+
+    int size() const { return (int)mHandles.size(); }
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_SynthVoice.hpp"
+
+// Voices allocated up front, started, rendered and retired on the audio
+// thread without locks or allocation.
+//
+// PolySynth's getVoice(), triggerOn() and triggerOff() take its internal
+// mutexes, and getVoice() allocates a voice when none of its class is
+// free, so a note started through them on the audio thread can wait on the
+// GUI thread. A VoicePool owns a fixed set of voices of one class, init()ed
+// when allocated, and keeps the free ones on a stack. A VoicePlayer renders
+// the voices started from any number of pools each block and puts each
+// back in its pool once it has freed itself.
+//
+// A pool also holds the patch each instrument it plays starts its notes
+// with, indexed by instrument; take() copies it into the voice. Params must
+// be all float fields, and Voice must have applyPatch(const Params &, amp,
+// freq), releaseAt(offset), level() and steal().
+class VoicePoolBase
+{
+public:
+    virtual ~VoicePoolBase() {}
+
+    // Allocate and init() n voices before any audio runs; later calls do
+    // nothing
+    virtual void allocate(int n) = 0;
+    virtual int size() const = 0;
+    // Voice i, e.g. for the graphics thread to draw the ones active()
+    virtual al::SynthVoice *voice(int i) = 0;
+
+    // --- audio thread ---
+
+    // A free voice patched as instrument playing freq at amp, or nullptr if
+    // every voice is playing
+    virtual al::SynthVoice *take(int instrument, float amp, float freq) = 0;
+    // Return a voice that has finished
+    virtual void give(al::SynthVoice *voice) = 0;
+
+    virtual void releaseAt(al::SynthVoice *voice, int offset) = 0;
+    virtual float level(al::SynthVoice *voice) = 0;
+    virtual void steal(al::SynthVoice *voice) = 0;
+
+    // The patch of instrument as an array of count float fields, indexed as
+    // patchParam() numbers them
+    virtual float *patchFields(int instrument, int &count) = 0;
+
+    // Graphics thread: draw the voices playing
+    void render(al::Graphics &g)
+    {
+        for (int i = 0; i < size(); i++)
+            if (voice(i)->active())
+                voice(i)->onProcess(g);
+    }
+};
+
+template <class Voice, class Params>
+class VoicePool : public VoicePoolBase
+{
+private:
+    Params *mPatches;
+    std::unique_ptr<Voice[]> mVoices;
+    std::vector<Voice *> mFree;
+    int mSize = 0;
+    int mNumFree = 0;
+
+public:
+    explicit VoicePool(Params *patches) : mPatches(patches) {}
+
+    void allocate(int n) override
+    {
+        if (mSize > 0)
+            return;
+        mVoices.reset(new Voice[n]);
+        mFree.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            mVoices[i].init();
+            mFree[i] = &mVoices[n - 1 - i]; // voice 0 is taken first
+        }
+        mSize = mNumFree = n;
+    }
+
+    int size() const override { return mSize; }
+    al::SynthVoice *voice(int i) override { return &mVoices[i]; }
+
+    al::SynthVoice *take(int instrument, float amp, float freq) override
+    {
+        if (mNumFree == 0)
+            return nullptr;
+        Voice *v = mFree[--mNumFree];
+        v->applyPatch(mPatches[instrument], amp, freq);
+        return v;
+    }
+
+    void give(al::SynthVoice *voice) override { mFree[mNumFree++] = static_cast<Voice *>(voice); }
+
+    void releaseAt(al::SynthVoice *voice, int offset) override { static_cast<Voice *>(voice)->releaseAt(offset); }
+    float level(al::SynthVoice *voice) override { return static_cast<Voice *>(voice)->level(); }
+    void steal(al::SynthVoice *voice) override { static_cast<Voice *>(voice)->steal(); }
+
+    float *patchFields(int instrument, int &count) override
+    {
+        count = sizeof(Params) / sizeof(float);
+        return reinterpret_cast<float *>(&mPatches[instrument]);
+    }
+};
+
+// Index of a patch field for VoicePoolBase::patchFields(), e.g.
+// patchParam(&MiniSubWavesParams::filtFreq)
+template <class Params>
+uint16_t patchParam(float Params::*field)
+{
+    Params p;
+    return (uint16_t)(&(p.*field) - reinterpret_cast<float *>(&p));
+}
+
+// The voices taken from VoicePools that are playing, on the audio thread.
+// render() renders each from its start offset, as PolySynth::render()
+// does, and then hands the ones that have freed themselves back to their
+// pool, calling onFree() on the way.
+class VoicePlayer
+{
+private:
+    struct Playing
+    {
+        al::SynthVoice *voice;
+        VoicePoolBase *pool;
+    };
+
+    std::vector<Playing> mPlaying;
+    int mSize = 0;
+
+public:
+    // Make room for n voices playing at once (every voice of the pools
+    // played from); call before any audio runs
+    void reserve(int n)
+    {
+        if (n > (int)mPlaying.size())
+            mPlaying.resize(n);
+    }
+
+    // Number of voices playing
+    int size() const { return mSize; }
+
+    // Trigger voice, just taken from pool, offset frames into the next
+    // block rendered. Returns false, and gives the voice back, if there is
+    // no room.
+    bool start(al::SynthVoice *voice, VoicePoolBase &pool, int id, int offset)
+    {
+        if (mSize == (int)mPlaying.size())
+        {
+            pool.give(voice);
+            return false;
+        }
+        voice->id(id);
+        voice->triggerOn(offset);
+        mPlaying[mSize++] = {voice, &pool};
+        return true;
+    }
+
+    // Release the playing voice with id offset frames into the next block
+    // rendered; false if there is none
+    bool release(int id, int offset)
+    {
+        for (int i = 0; i < mSize; i++)
+            if (mPlaying[i].voice->active() && mPlaying[i].voice->id() == id)
+            {
+                mPlaying[i].pool->releaseAt(mPlaying[i].voice, offset);
+                return true;
+            }
+        return false;
+    }
+
+    void render(al::AudioIOData &io)
+    {
+        int frames = io.framesPerBuffer();
+        for (int i = 0; i < mSize; i++)
+        {
+            al::SynthVoice *voice = mPlaying[i].voice;
+            if (!voice->active())
+                continue;
+            int offset = voice->getStartOffsetFrames(frames);
+            if (offset < frames)
+            {
+                io.frame(offset);
+                voice->onProcess(io);
+            }
+        }
+
+        // in start order, so the voices left keep rendering in the same order
+        int kept = 0;
+        for (int i = 0; i < mSize; i++)
+        {
+            Playing &p = mPlaying[i];
+            if (p.voice->active())
+            {
+                mPlaying[kept++] = p;
+                continue;
+            }
+            p.voice->id(-1);
+            p.voice->onFree();
+            p.pool->give(p.voice);
+        }
+        mSize = kept;
+    }
+};
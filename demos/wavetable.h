@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Band-limited wavetables, one mipmap level per octave, shared by every
+// voice.
+//
+// build() sums each shape's harmonics once for the sample rate. Level i
+// holds a note of up to WAVETABLE_LOWEST_TOP * 2^i Hz, with only the
+// harmonics that stay below Nyquist at that top frequency, so no note
+// ever aliases. A WavetableOsc then costs one linearly interpolated lookup
+// per table per sample. The price is brightness: a note near the bottom of
+// its level has no harmonics above about a quarter of the sample rate.
+enum WaveShape
+{
+    WAVE_SAW,
+    WAVE_SQUARE,
+    NUM_WAVE_SHAPES
+};
+
+static const int WAVETABLE_SIZE_BITS = 11;
+static const int WAVETABLE_SIZE = 1 << WAVETABLE_SIZE_BITS;
+static const int WAVETABLE_LEVELS = 10;
+static const float WAVETABLE_LOWEST_TOP = 40.0f; // Hz, top of level 0
+
+class WavetableBank
+{
+public:
+    // floats from one shape's table for a level to the next shape's
+    static const int SHAPE_STRIDE = WAVETABLE_LEVELS * (WAVETABLE_SIZE + 1);
+
+private:
+    // each table has one guard point past the end for interpolation
+    std::vector<float> mTables;
+    float mSampleRate = 0.0f;
+
+    float *at(int shape, int level) { return &mTables[shape * SHAPE_STRIDE + level * (WAVETABLE_SIZE + 1)]; }
+
+    // Sum harmonics 1 .. numHarmonics of shape into t, peak-normalized
+    static void sumHarmonics(float *t, int shape, int numHarmonics)
+    {
+        std::vector<double> sum(WAVETABLE_SIZE, 0.0);
+        for (int i = 0; i < WAVETABLE_SIZE; i++)
+        {
+            // sin(k x) for every k by rotating (cos x, sin x)
+            double x = 2.0 * M_PI * i / WAVETABLE_SIZE;
+            double c = std::cos(x), s = std::sin(x);
+            double ck = c, sk = s;
+            double v = 0.0;
+            for (int k = 1; k <= numHarmonics; k++)
+            {
+                if (shape == WAVE_SAW)
+                    v -= sk / k; // rising ramp
+                else if (k & 1)
+                    v += sk / k; // square: odd harmonics only
+                double next = ck * c - sk * s;
+                sk = sk * c + ck * s;
+                ck = next;
+            }
+            sum[i] = v;
+        }
+        double peak = 0.0;
+        for (double v : sum)
+            peak = std::fabs(v) > peak ? std::fabs(v) : peak;
+        for (int i = 0; i < WAVETABLE_SIZE; i++)
+            t[i] = (float)(sum[i] / peak);
+        t[WAVETABLE_SIZE] = t[0];
+    }
+
+public:
+    // Compute every table for sampleRate; does nothing if they already are
+    void build(float sampleRate)
+    {
+        if (sampleRate == mSampleRate)
+            return;
+        mSampleRate = sampleRate;
+        mTables.assign(NUM_WAVE_SHAPES * WAVETABLE_LEVELS * (WAVETABLE_SIZE + 1), 0.0f);
+        for (int level = 0; level < WAVETABLE_LEVELS; level++)
+        {
+            float top = WAVETABLE_LOWEST_TOP * (float)(1 << level);
+            int harmonics = (int)(0.5f * sampleRate / top);
+            if (harmonics > WAVETABLE_SIZE / 2 - 1)
+                harmonics = WAVETABLE_SIZE / 2 - 1;
+            if (harmonics < 1)
+                harmonics = 1;
+            for (int shape = 0; shape < NUM_WAVE_SHAPES; shape++)
+                sumHarmonics(at(shape, level), shape, harmonics);
+        }
+    }
+
+    float sampleRate() const { return mSampleRate; }
+
+    // The level for a note at freq Hz: the lowest whose top is at or above it
+    static int level(float freq)
+    {
+        int level = 0;
+        float top = WAVETABLE_LOWEST_TOP;
+        while (level < WAVETABLE_LEVELS - 1 && freq > top)
+        {
+            top *= 2.0f;
+            level++;
+        }
+        return level;
+    }
+
+    // Where the table for a note at freq Hz starts in data()
+    static int offset(int shape, float freq) { return shape * SHAPE_STRIDE + level(freq) * (WAVETABLE_SIZE + 1); }
+
+    // Every table, for code that indexes them from one base pointer
+    const float *data() const { return mTables.data(); }
+
+    const float *table(int shape, float freq) const { return data() + offset(shape, freq); }
+};
+
+// Oscillator reading a WavetableBank. Saw and square share one phase, so
+// mix() blends the two with a single phase step and index computation.
+class WavetableOsc
+{
+private:
+    static const int FRAC_BITS = 32 - WAVETABLE_SIZE_BITS;
+
+    const float *mSaw = nullptr;
+    const float *mSquare = nullptr;
+    uint32_t mPhase = 0;
+    uint32_t mInc = 0;
+
+    static float lookup(const float *t, uint32_t index, float frac)
+    {
+        return t[index] + frac * (t[index + 1] - t[index]);
+    }
+
+public:
+    // Play freq Hz from the bank's tables, which must be built; call again
+    // whenever freq changes
+    void freq(const WavetableBank &bank, float freq)
+    {
+        mSaw = bank.table(WAVE_SAW, freq);
+        mSquare = bank.table(WAVE_SQUARE, freq);
+        mInc = (uint32_t)(int64_t)(freq / bank.sampleRate() * 4294967296.0);
+    }
+
+    void reset() { mPhase = 0; }
+
+    // Next sample of (1 - mix) * saw + mix * square
+    float mix(float mix)
+    {
+        uint32_t index = mPhase >> FRAC_BITS;
+        float frac = (mPhase & ((1u << FRAC_BITS) - 1)) * (1.0f / (1u << FRAC_BITS));
+        mPhase += mInc;
+        float saw = lookup(mSaw, index, frac);
+        float square = lookup(mSquare, index, frac);
+        return saw + mix * (square - saw);
+    }
+
+    float saw()
+    {
+        uint32_t index = mPhase >> FRAC_BITS;
+        float frac = (mPhase & ((1u << FRAC_BITS) - 1)) * (1.0f / (1u << FRAC_BITS));
+        mPhase += mInc;
+        return lookup(mSaw, index, frac);
+    }
+
+    float square()
+    {
+        uint32_t index = mPhase >> FRAC_BITS;
+        float frac = (mPhase & ((1u << FRAC_BITS) - 1)) * (1.0f / (1u << FRAC_BITS));
+        mPhase += mInc;
+        return lookup(mSquare, index, frac);
+    }
+};